@@ -4,37 +4,61 @@
 
 #include "namespaces.h"
 
-#include <SDL.h>
+#include "pcm_convert.h"
 
 namespace detail {
     static constexpr int out_sample_rate = 48000;
-    static constexpr SDL_AudioFormat sdl_out_sample_format = AUDIO_S16LSB;
-    static constexpr AVSampleFormat av_out_sample_format = AV_SAMPLE_FMT_S16;
+    static constexpr sample_format out_sample_format = sample_format::int16;
     static constexpr int64_t out_channel_count = 2;
-    static constexpr uint64_t out_channel_layout = AV_CH_LAYOUT_STEREO;
     static constexpr int out_buffer_size = 4096;
 
     static constexpr size_t out_sample_size = 2;
+    static constexpr size_t out_frame_size = out_sample_size * out_channel_count;
 
-    static constexpr ffmpeg::swresample::context::audio_info output_audio {
-        .channel_layout = out_channel_layout,
-        .sample_format = av_out_sample_format,
-        .sample_rate = out_sample_rate
-    };
+    // Samples stay float until the gain is applied in the audio callback
+    static constexpr size_t mix_frame_size = sizeof(float) * out_channel_count;
+
+    // How far the decoder thread works ahead
+    static constexpr size_t decode_ahead_ms = 500;
+    static constexpr size_t ring_size = (out_sample_rate * decode_ahead_ms / 1000) * mix_frame_size;
+
+    // Volume changes are spread over 10 ms
+    static constexpr int64_t gain_ramp_frames = out_sample_rate / 100;
+
+    static constexpr resampler::quality resample_quality = resampler::quality::balanced;
+
+    // Mono is spread over both channels, anything above stereo folded down
+    static std::optional<downmix> make_downmix(pcm_provider& provider) {
+        if (provider.channels() == out_channel_count) {
+            return std::nullopt;
+        }
+
+        return downmix::stereo(provider.channel_layout(), provider.channels());
+    }
 }
 
-audio_player::audio_player(pcm_provider_ptr provider)
+audio_player::audio_player(pcm_provider_ptr provider, const audio_sink::factory& make_sink)
     : _provider { std::move(provider) }
-    , _device { detail::out_sample_rate, detail::sdl_out_sample_format, detail::out_channel_count,
-        detail::out_buffer_size, std::bind(&audio_player::_audio_callback, this) }
-    , _swr { { av_get_default_channel_layout(utils::narrow<int>(_provider->channels())),
-                av_get_packed_sample_fmt(samples::to_av(_provider->format())),
-                utils::narrow<int>(_provider->rate())  },
-            detail::output_audio } {
-
+    , _ring { detail::ring_size }
+    , _mix(detail::out_buffer_size * detail::out_channel_count)
+    , _gain { 1.f, detail::gain_ramp_frames }
+    , _sink { make_sink({ detail::out_sample_rate, detail::out_sample_format, detail::out_channel_count, detail::out_buffer_size },
+        std::bind(&audio_player::_audio_callback, this, std::placeholders::_1, std::placeholders::_2)) }
+    , _in_fmt { samples::from_av(av_get_packed_sample_fmt(samples::to_av(_provider->format()))) }
+    , _resampler { resampler::create(resampler::kind::polyphase, _provider->channels(),
+        _provider->rate(), detail::out_sample_rate, detail::resample_quality) }
+    , _downmix { detail::make_downmix(*_provider) } {
+    _decoder = std::thread(&audio_player::_decode_loop, this);
 }
 
 audio_player::~audio_player() {
+    // No more callbacks after this
+    _sink.reset();
+
+    _stop = true;
+    _wake_decoder();
+    _decoder.join();
+
     trigger_event(EVENT_STOP);
 }
 
@@ -43,11 +67,22 @@ std::chrono::nanoseconds audio_player::duration() const {
 }
 
 std::chrono::nanoseconds audio_player::pos() const {
-    return _provider->pos();
+    // Nothing from the last seek played yet, frames still counted belong to the old position
+    if (_played_gen != _seek_gen) {
+        return std::chrono::nanoseconds { _base_ns };
+    }
+
+    return std::chrono::nanoseconds { _base_ns + (_played * 1'000'000'000 / detail::out_sample_rate) };
 }
 
-void audio_player::seek(std::chrono::nanoseconds pos) const {
-    _provider->seek(pos);
+void audio_player::seek(std::chrono::nanoseconds pos) {
+    _base_ns = pos.count();
+    _eof = false;
+
+    // Performed by the decoder thread, which owns the provider
+    _seek_ns = pos.count();
+    ++_seek_gen;
+    _wake_decoder();
 }
 
 bool audio_player::paused() const {
@@ -58,21 +93,24 @@ bool audio_player::eof() const {
     return _eof;
 }
 
+bool audio_player::failed() const {
+    return _failed;
+}
+
 void audio_player::pause() {
     _paused = true;
-    _device.pause();
+    _sink->pause();
 
     trigger_event(EVENT_STOP);
 }
 
 void audio_player::play() {
     _paused = false;
-    _device.play();
+    _sink->play();
 
     trigger_event(EVENT_START);
 }
 
-
 void audio_player::set_volume_scaled(float val) {
     _volume = std::clamp(val, 0.f, 1.f);
 }
@@ -113,30 +151,142 @@ sample_format audio_player::pcm_format() const {
     return _provider->format();
 }
 
-std::vector<char> audio_player::_audio_callback() {
-    (void) this;
-    pcm_samples samples = _provider->get_samples();
+uint64_t audio_player::underruns() const {
+    return _underruns;
+}
+
+size_t audio_player::_audio_callback(char* buffer, size_t len) {
+    // Whole frames only, as many as the mix buffer holds, the device asks again for the rest
+    const size_t wanted = std::min(len / detail::out_frame_size, _mix.size() / detail::out_channel_count);
+
+    // The ring still holds audio from before the last seek, play silence until the decoder clears it
+    const int64_t gen = _ring_gen;
+    if (gen != _seek_gen) {
+        return 0;
+    }
+
+    if (gen != _played_gen) {
+        _played = 0;
+        _played_gen = gen;
+    }
 
-    if (!samples) {
-        _eof = true;
-        pause();
-        return { };
+    size_t read = _ring.read(reinterpret_cast<char*>(_mix.data()), wanted * detail::mix_frame_size);
+    if (read == 0) {
+        if (_eof_gen == _seek_gen) {
+            _eof = true;
+            pause();
+        } else {
+            // Decoder fell behind, play silence
+            ++_underruns;
+        }
+
+        return 0;
     }
 
-    int64_t max_out_frames = _swr.frames_for_input(samples.frames());
-    std::vector<char> result(max_out_frames * detail::out_sample_size * detail::out_channel_count);
+    _wake_decoder();
+
+    // Decoder only writes whole frames
+    const size_t frames = read / detail::mix_frame_size;
 
-    char* in = samples.data();
-    char* out = result.data();
-    int64_t converted = _swr.convert(&in, samples.frames(), &out, max_out_frames);
+    _played += frames;
+
+    _gain.set(_volume);
+    _gain.apply(_mix.data(), detail::out_channel_count, frames, reinterpret_cast<sample_int16_t*>(buffer));
+
+    return frames * detail::out_frame_size;
+}
 
-    result.resize(converted * detail::out_sample_size * detail::out_channel_count);
+void audio_player::_decode_loop() {
+    const auto channels = static_cast<size_t>(_provider->channels());
 
-    auto data = reinterpret_cast<sample_int16_t*>(result.data());
+    // Reused between iterations
+    std::vector<float> converted;
+    std::vector<float> resampled;
+    std::vector<float> downmixed;
 
-    for (int64_t i = 0; i < (converted * detail::out_channel_count); ++i) {
-        data[i] = utils::narrow<sample_int16_t>(data[i] * _volume);
+    // Seek generation the provider's position belongs to
+    int64_t gen = 0;
+
+    while (!_stop) {
+        uint64_t wake = _wake;
+
+        if (const int64_t requested = _seek_gen; requested != gen) {
+            gen = requested;
+            _failed = false;
+
+            _provider->seek(std::chrono::nanoseconds { _seek_ns });
+            _resampler->reset();
+            _ring.clear();
+            _ring_gen = gen;
+        }
+
+        if (_eof_gen == gen) {
+            // Nothing to do until a seek or shutdown
+            _wake.wait(wake);
+            continue;
+        }
+
+        try {
+            pcm_samples samples = _provider->get_samples();
+
+            if (!samples) {
+                // Whatever the resampler held back is the last of it
+                resampled.resize(_resampler->max_output(0) * channels);
+                int64_t frames = _resampler->flush(resampled.data(), _resampler->max_output(0));
+
+                if (_push(resampled.data(), frames, downmixed, gen)) {
+                    _eof_gen = gen;
+                }
+
+                continue;
+            }
+
+            converted.resize(samples.samples());
+            samples::convert(samples.data(), _in_fmt, reinterpret_cast<char*>(converted.data()), sample_format::float32, samples.samples());
+
+            const int64_t max_out_frames = _resampler->max_output(samples.frames());
+            resampled.resize(max_out_frames * channels);
+
+            int64_t frames = _resampler->process(converted.data(), samples.frames(), resampled.data(), max_out_frames);
+
+            _push(resampled.data(), frames, downmixed, gen);
+        } catch (const std::exception& e) {
+            nao::coutln("decoding failed:", e.what());
+
+            // Play out what's already in the ring, the callback then stops like at the end of the stream
+            _failed = true;
+            _eof_gen = gen;
+        }
+    }
+}
+
+bool audio_player::_push(const float* data, int64_t frames, std::vector<float>& downmixed, int64_t gen) {
+    if (_downmix) {
+        downmixed.resize(frames * detail::out_channel_count);
+        _downmix->apply(data, frames, downmixed.data());
+
+        data = downmixed.data();
+    }
+
+    // Hand everything over, waiting for space while the ring is full
+    const auto bytes = static_cast<size_t>(frames * detail::mix_frame_size);
+    auto src = reinterpret_cast<const char*>(data);
+    size_t written = 0;
+
+    while (written < bytes && !_stop && _seek_gen == gen) {
+        uint64_t wake = _wake;
+
+        written += _ring.write(src + written, bytes - written);
+
+        if (written < bytes) {
+            _wake.wait(wake);
+        }
     }
 
-    return result;
+    return written == bytes;
+}
+
+void audio_player::_wake_decoder() {
+    ++_wake;
+    _wake.notify_one();
 }
@@ -3,8 +3,14 @@
 #include "pcm_provider.h"
 #include "thread_pool.h"
 
-#include "sdl2.h"
+#include "audio_sink.h"
 #include "ffmpeg.h"
+#include "spsc_ring.h"
+#include "gain_ramp.h"
+#include "downmix.h"
+#include "resampler.h"
+
+#include <optional>
 
 enum event_type {
     EVENT_START,
@@ -17,26 +23,70 @@ class audio_player {
 
     private:
     pcm_provider_ptr _provider;
-    sdl::audio::device _device;
 
-    float _volume = 1.f;
-    bool _eof = false;
+    // Converted samples, filled ahead by the decoder thread and drained by the audio callback
+    spsc_ring _ring;
+
+    // Float samples taken from the ring, and the gain applied to them, only used by the audio callback
+    std::vector<float> _mix;
+    gain_ramp _gain;
+
+    std::unique_ptr<audio_sink> _sink;
+
+    // Target volume, reached by _gain over a short ramp
+    std::atomic<float> _volume = 1.f;
+    std::atomic<bool> _eof = false;
     bool _paused = true;
 
     std::unordered_map<event_type, std::vector<event_handler>> _events;
 
-    ffmpeg::swresample::context _swr;
+    // Source format, interleaved as returned by the provider
+    sample_format _in_fmt;
+
+    // Samples are converted to float, resampled, then mapped to stereo by the provider's channel mask
+    std::unique_ptr<resampler> _resampler;
+    std::optional<downmix> _downmix;
+
+    // Playback position is the last seek target plus the frames played since,
+    // counted by the audio callback only once it plays audio from that seek
+    std::atomic<int64_t> _base_ns = 0;
+    std::atomic<int64_t> _played = 0;
+    std::atomic<int64_t> _played_gen = 0;
+
+    std::atomic<uint64_t> _underruns = 0;
+
+    // Decoder thread state, the provider is only used from that thread once it runs
+    std::atomic<bool> _stop = false;
+    std::atomic<int64_t> _seek_ns = 0;
+
+    // Bumped by every seek. The decoder tags the end of the stream with the generation it reached it in,
+    // so an end found at the old position never stops playback from the new one.
+    std::atomic<int64_t> _seek_gen = 0;
+    std::atomic<int64_t> _eof_gen = -1;
+
+    // Generation of the audio in the ring, set once the decoder has sought and cleared the ring
+    std::atomic<int64_t> _ring_gen = 0;
+
+    // Decoding stopped on an error rather than the end of the stream
+    std::atomic<bool> _failed = false;
+
+    // Bumped whenever the decoder may have something to do
+    std::atomic<uint64_t> _wake = 0;
+
+    std::thread _decoder;
 
     public:
-    explicit audio_player(pcm_provider_ptr provider);
+    // Plays through the sink made by the factory, the default audio device if none is given
+    explicit audio_player(pcm_provider_ptr provider, const audio_sink::factory& make_sink = sdl_sink::create);
     ~audio_player();
 
     std::chrono::nanoseconds duration() const;
     std::chrono::nanoseconds pos() const;
-    void seek(std::chrono::nanoseconds pos) const;
+    void seek(std::chrono::nanoseconds pos);
 
     bool paused() const;
     bool eof() const;
+    bool failed() const;
     void pause();
     void play();
 
@@ -51,6 +101,15 @@ class audio_player {
     pcm_provider* provider() const;
     sample_format pcm_format() const;
 
+    // Number of callbacks that found no decoded audio ready
+    uint64_t underruns() const;
+
     private:
-    std::vector<char> _audio_callback();
+    size_t _audio_callback(char* buffer, size_t len);
+
+    void _decode_loop();
+
+    // Mix to stereo and hand over to the audio callback, false if interrupted by a seek past generation gen or shutdown
+    bool _push(const float* data, int64_t frames, std::vector<float>& downmixed, int64_t gen);
+    void _wake_decoder();
 };
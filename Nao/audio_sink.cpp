@@ -0,0 +1,193 @@
+#include "audio_sink.h"
+
+#include "riff.h"
+
+namespace detail {
+    static SDL_AudioFormat to_sdl(sample_format fmt) {
+        switch (fmt) {
+            case sample_format::uint8:   return AUDIO_U8;
+            case sample_format::int16:   return AUDIO_S16LSB;
+            case sample_format::int32:   return AUDIO_S32LSB;
+            case sample_format::float32: return AUDIO_F32LSB;
+            default: throw std::invalid_argument("unsupported output format " + samples::format_name(fmt));
+        }
+    }
+
+    // First wait of a null_sink after the callback had nothing
+    static constexpr std::chrono::nanoseconds min_backoff = std::chrono::milliseconds(1);
+
+    static size_t frame_size(const audio_sink::spec& spec) {
+        return samples::sample_size(spec.format) * spec.channels;
+    }
+}
+
+sdl_sink::sdl_sink(const spec& spec, callback cb)
+    : _device { spec.rate, detail::to_sdl(spec.format), spec.channels, spec.buffer_frames, std::move(cb) } {
+
+}
+
+void sdl_sink::pause() {
+    _device.pause();
+}
+
+void sdl_sink::play() {
+    _device.play();
+}
+
+std::unique_ptr<audio_sink> sdl_sink::create(const spec& spec, callback cb) {
+    return std::make_unique<sdl_sink>(spec, std::move(cb));
+}
+
+null_sink::null_sink(const spec& spec, callback cb)
+    : _cb { std::move(cb) }, _buf(spec.buffer_frames * detail::frame_size(spec))
+    , _period { static_cast<int64_t>(spec.buffer_frames) * 1'000'000'000 / spec.rate } {
+    ASSERT(!_buf.empty());
+
+    _thread = std::thread(&null_sink::_run, this);
+}
+
+null_sink::~null_sink() {
+    stop();
+}
+
+void null_sink::pause() {
+    _playing = false;
+    _notify();
+}
+
+void null_sink::play() {
+    _playing = true;
+    _notify();
+}
+
+uint64_t null_sink::pulled() const {
+    return _pulled;
+}
+
+uint64_t null_sink::callbacks() const {
+    return _callbacks;
+}
+
+std::unique_ptr<audio_sink> null_sink::create(const spec& spec, callback cb) {
+    return std::make_unique<null_sink>(spec, std::move(cb));
+}
+
+void null_sink::stop() {
+    if (_thread.joinable()) {
+        _stop = true;
+        _notify();
+        _thread.join();
+    }
+}
+
+void null_sink::consume(const char*, size_t) {
+
+}
+
+void null_sink::_run() {
+    std::unique_lock lock { _mutex };
+
+    // Doubled by every empty callback in a row, up to a period
+    std::chrono::nanoseconds backoff = detail::min_backoff;
+
+    while (!_stop) {
+        const uint64_t wake = _wake;
+
+        if (!_playing) {
+            _cv.wait(lock, [&] { return _wake != wake; });
+            continue;
+        }
+
+        lock.unlock();
+
+        size_t written = _cb(_buf.data(), _buf.size());
+        ++_callbacks;
+
+        if (written == 0) {
+            // Underrun or end of file, give the decoder time to catch up unless the state changes
+            lock.lock();
+            _cv.wait_for(lock, backoff, [&] { return _wake != wake; });
+
+            backoff = std::min(backoff * 2, _period);
+            continue;
+        }
+
+        backoff = detail::min_backoff;
+
+        consume(_buf.data(), written);
+        _pulled += written;
+
+        lock.lock();
+    }
+}
+
+void null_sink::_notify() {
+    {
+        std::scoped_lock lock { _mutex };
+        ++_wake;
+    }
+
+    _cv.notify_one();
+}
+
+wav_sink::wav_sink(const std::filesystem::path& path, const spec& spec, callback cb)
+    : null_sink(spec, std::move(cb)), _file { path, std::ios::binary | std::ios::trunc } {
+    ASSERT(_file);
+
+    _write_header(spec);
+}
+
+wav_sink::~wav_sink() {
+    // Nothing is written after this
+    stop();
+
+    // Fill in the sizes
+    const uint32_t data_offset = sizeof(riff_header) + sizeof(wave_chunk) + sizeof(riff_header) + sizeof(fmt_chunk);
+
+    _file.seekp(0);
+    riff_header riff { { 'R', 'I', 'F', 'F' }, data_offset + _data_size };
+    _file.write(reinterpret_cast<const char*>(&riff), sizeof(riff));
+
+    _file.seekp(data_offset);
+    riff_header data { { 'd', 'a', 't', 'a' }, _data_size };
+    _file.write(reinterpret_cast<const char*>(&data), sizeof(data));
+}
+
+audio_sink::factory wav_sink::to_file(const std::filesystem::path& path) {
+    return [path](const spec& spec, callback cb) -> std::unique_ptr<audio_sink> {
+        return std::make_unique<wav_sink>(path, spec, std::move(cb));
+    };
+}
+
+void wav_sink::consume(const char* data, size_t size) {
+    _file.write(data, static_cast<std::streamsize>(size));
+    _data_size += static_cast<uint32_t>(size);
+}
+
+void wav_sink::_write_header(const spec& spec) {
+    const bool is_float = spec.format == sample_format::float32;
+    const auto sample_size = static_cast<uint16_t>(samples::sample_size(spec.format));
+
+    riff_header riff { { 'R', 'I', 'F', 'F' }, 0 };
+    wave_chunk wave { { 'W', 'A', 'V', 'E' } };
+    riff_header fmt_header { { 'f', 'm', 't', ' ' }, sizeof(fmt_chunk) };
+
+    fmt_chunk fmt {
+        // IEEE float or integer PCM
+        .format = static_cast<uint16_t>(is_float ? 0x0003 : 0x0001),
+        .channels = spec.channels,
+        .rate = static_cast<uint32_t>(spec.rate),
+        .byte_rate = static_cast<uint32_t>(spec.rate * sample_size * spec.channels),
+        .align = static_cast<uint16_t>(sample_size * spec.channels),
+        .bits = static_cast<uint16_t>(sample_size * 8)
+    };
+
+    // Sizes are filled in once everything is written
+    riff_header data { { 'd', 'a', 't', 'a' }, 0 };
+
+    _file.write(reinterpret_cast<const char*>(&riff), sizeof(riff));
+    _file.write(reinterpret_cast<const char*>(&wave), sizeof(wave));
+    _file.write(reinterpret_cast<const char*>(&fmt_header), sizeof(fmt_header));
+    _file.write(reinterpret_cast<const char*>(&fmt), sizeof(fmt));
+    _file.write(reinterpret_cast<const char*>(&data), sizeof(data));
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "pcm_provider.h"
+#include "sdl2.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <filesystem>
+
+// Output for an audio_player, pulls samples through a callback while playing
+class audio_sink {
+    public:
+    // Write up to len bytes of samples to the buffer and return the number of bytes written, 0 if there are none
+    using callback = std::function<size_t(char* buffer, size_t len)>;
+
+    struct spec {
+        int rate;
+        sample_format format;
+        uint8_t channels;
+
+        // Frames requested per callback
+        uint16_t buffer_frames;
+    };
+
+    // Creates the sink an audio_player plays through
+    using factory = std::function<std::unique_ptr<audio_sink>(const spec&, callback)>;
+
+    virtual ~audio_sink() = default;
+
+    // Start or stop pulling samples, safe to call from the callback
+    virtual void pause() = 0;
+    virtual void play() = 0;
+};
+
+// Plays through the default SDL audio device
+class sdl_sink : public audio_sink {
+    sdl::audio::device _device;
+
+    public:
+    sdl_sink(const spec& spec, callback cb);
+
+    void pause() override;
+    void play() override;
+
+    static std::unique_ptr<audio_sink> create(const spec& spec, callback cb);
+};
+
+// Pulls samples on its own thread as fast as the callback provides them
+class null_sink : public audio_sink {
+    callback _cb;
+    std::vector<char> _buf;
+
+    // Time the buffer plays for, the longest wait when the callback has nothing
+    std::chrono::nanoseconds _period;
+
+    std::atomic<bool> _playing = false;
+    std::atomic<bool> _stop = false;
+
+    // Bumped on every state change
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    uint64_t _wake = 0;
+
+    std::atomic<uint64_t> _pulled = 0;
+    std::atomic<uint64_t> _callbacks = 0;
+
+    std::thread _thread;
+
+    public:
+    null_sink(const spec& spec, callback cb);
+    ~null_sink() override;
+
+    void pause() override;
+    void play() override;
+
+    // Bytes received so far
+    uint64_t pulled() const;
+
+    // Callbacks made so far, including ones that returned nothing
+    uint64_t callbacks() const;
+
+    static std::unique_ptr<audio_sink> create(const spec& spec, callback cb);
+
+    protected:
+    // Stop the thread, derived classes must call this before their members are destroyed
+    void stop();
+
+    // Called on the sink thread with every block of samples
+    virtual void consume(const char* data, size_t size);
+
+    private:
+    void _run();
+    void _notify();
+};
+
+// Writes everything played to a WAV file, as fast as the callback provides it
+class wav_sink : public null_sink {
+    std::ofstream _file;
+    uint32_t _data_size = 0;
+
+    public:
+    wav_sink(const std::filesystem::path& path, const spec& spec, callback cb);
+    ~wav_sink() override;
+
+    // Factory writing to the specified path
+    static factory to_file(const std::filesystem::path& path);
+
+    protected:
+    void consume(const char* data, size_t size) override;
+
+    private:
+    void _write_header(const spec& spec);
+};
@@ -101,6 +101,10 @@ void binary_istream::clear() {
     file->clear();
 }
 
+std::streambuf* binary_istream::rdbuf() const {
+    return file->rdbuf();
+}
+
 class binary_istream& binary_istream::rseek(pos_type pos) {
     std::unique_lock lock(mutex);
     file->seekg(pos, std::ios::cur);
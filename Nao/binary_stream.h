@@ -81,6 +81,9 @@ class binary_istream {
 
     virtual void clear();
 
+    // Underlying streambuf
+    std::streambuf* rdbuf() const;
+
     // Seek with std::ios::cur
     binary_istream& rseek(pos_type pos);
 
@@ -0,0 +1,134 @@
+#include "downmix.h"
+
+#include "utils.h"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace detail {
+    // WAVEFORMATEXTENSIBLE speaker bits
+    enum speaker : uint64_t {
+        front_left            = 0x1,
+        front_right           = 0x2,
+        front_center          = 0x4,
+        low_frequency         = 0x8,
+        back_left             = 0x10,
+        back_right            = 0x20,
+        front_left_of_center  = 0x40,
+        front_right_of_center = 0x80,
+        back_center           = 0x100,
+        side_left             = 0x200,
+        side_right            = 0x400
+    };
+
+    // Outputs are padded to a full vector
+    static constexpr size_t max_out = 4;
+}
+
+downmix::downmix(size_t in_channels, size_t out_channels, const std::vector<float>& matrix)
+    : _in { in_channels }, _out { out_channels }, _columns(in_channels * detail::max_out, 0.f) {
+    ASSERT(_in > 0 && _out > 0 && _out <= detail::max_out);
+    ASSERT(matrix.size() == _in * _out);
+
+    for (size_t o = 0; o < _out; ++o) {
+        for (size_t i = 0; i < _in; ++i) {
+            _columns[(i * detail::max_out) + o] = matrix[(o * _in) + i];
+        }
+    }
+}
+
+downmix downmix::stereo(uint64_t layout, size_t channels, const levels& mix) {
+    std::vector<float> matrix(2 * channels, 0.f);
+
+    // Channels appear in the order of their speaker bits
+    size_t index = 0;
+    for (uint64_t bit = 1; bit != 0 && index < channels; bit <<= 1) {
+        if (!(layout & bit)) {
+            continue;
+        }
+
+        float& left = matrix[index];
+        float& right = matrix[channels + index];
+
+        switch (bit) {
+            case detail::front_left:
+            case detail::front_left_of_center:  left = 1.f; break;
+            case detail::front_right:
+            case detail::front_right_of_center: right = 1.f; break;
+            case detail::front_center:          left = right = mix.center; break;
+            case detail::low_frequency:         left = right = mix.lfe; break;
+            case detail::back_left:
+            case detail::side_left:             left = mix.surround; break;
+            case detail::back_right:
+            case detail::side_right:            right = mix.surround; break;
+            case detail::back_center:           left = right = mix.surround * 0.70710678f; break;
+
+            // Top speakers are dropped
+            default: break;
+        }
+
+        ++index;
+    }
+
+    if (mix.normalize) {
+        float max = 0.f;
+        for (size_t o = 0; o < 2; ++o) {
+            float sum = 0.f;
+            for (size_t i = 0; i < channels; ++i) {
+                sum += std::abs(matrix[(o * channels) + i]);
+            }
+
+            max = std::max(max, sum);
+        }
+
+        if (max > 1.f) {
+            for (float& coef : matrix) {
+                coef /= max;
+            }
+        }
+    }
+
+    return { channels, 2, matrix };
+}
+
+downmix downmix::stereo(uint64_t layout, size_t channels) {
+    return stereo(layout, channels, { });
+}
+
+size_t downmix::in_channels() const {
+    return _in;
+}
+
+size_t downmix::out_channels() const {
+    return _out;
+}
+
+float downmix::coefficient(size_t out, size_t in) const {
+    return _columns[(in * detail::max_out) + out];
+}
+
+void downmix::apply(const float* in, size_t frames, float* out) const {
+    // Every input sample is broadcast and scaled by its column, which holds all outputs at once
+    for (size_t f = 0; f < frames; ++f) {
+        __m128 acc = _mm_setzero_ps();
+
+        for (size_t i = 0; i < _in; ++i) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(in[i]), _mm_loadu_ps(&_columns[i * detail::max_out])));
+        }
+
+        if (_out == 2) {
+            _mm_storel_pi(reinterpret_cast<__m64*>(out), acc);
+        } else if (_out == 4) {
+            _mm_storeu_ps(out, acc);
+        } else {
+            alignas(16) float result[detail::max_out];
+            _mm_store_ps(result, acc);
+            std::copy_n(result, _out, out);
+        }
+
+        in += _in;
+        out += _out;
+    }
+}
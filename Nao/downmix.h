@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Mixes interleaved float frames into fewer channels with a coefficient matrix
+class downmix {
+    public:
+    // Mix levels relative to the front channels, applied to channels without a matching output speaker
+    struct levels {
+        float center = 0.70710678f;
+        float surround = 0.70710678f;
+        float lfe = 0.f;
+
+        // Scale everything down so no output can exceed full scale
+        bool normalize = true;
+    };
+
+    private:
+    size_t _in;
+    size_t _out;
+
+    // Coefficients for every input channel, padded to 4 outputs
+    std::vector<float> _columns;
+
+    public:
+    // Matrix with in coefficients per output channel, row after row
+    downmix(size_t in_channels, size_t out_channels, const std::vector<float>& matrix);
+
+    // Standard stereo fold-down for a WAVEFORMATEXTENSIBLE channel mask
+    static downmix stereo(uint64_t layout, size_t channels, const levels& mix);
+    static downmix stereo(uint64_t layout, size_t channels);
+
+    size_t in_channels() const;
+    size_t out_channels() const;
+
+    float coefficient(size_t out, size_t in) const;
+
+    // Mix frames frames from in to out, which must not overlap
+    void apply(const float* in, size_t frames, float* out) const;
+};
@@ -254,10 +254,14 @@ namespace ffmpeg {
 
         bool context::seek(std::chrono::nanoseconds pos, int index) {
             return av_seek_frame(_ctx, index,
-                pos / std::chrono::nanoseconds { static_cast<int64_t>(_streams[index].time_base() * 1e9) },
+                av_rescale_q(pos.count(), { 1, 1'000'000'000 }, static_cast<AVStream*>(_streams[index])->time_base),
                 AVSEEK_FLAG_ANY) >= 0;
         }
 
+        bool context::seek_byte(int64_t offset, int index) {
+            return av_seek_frame(_ctx, index, offset, AVSEEK_FLAG_BYTE) >= 0;
+        }
+
     }
 
     namespace avcodec {
@@ -334,6 +338,10 @@ namespace ffmpeg {
             return avcodec_receive_frame(_ctx, frame);
         }
 
+        void context::flush() const {
+            avcodec_flush_buffers(_ctx);
+        }
+
         AVCodecContext* context::ctx() const {
             return _ctx;
         }
@@ -356,7 +364,7 @@ namespace ffmpeg {
                 in.channel_layout,
                 in.sample_format,
                 utils::narrow<int>(in.sample_rate), 0, nullptr) }
-            , _in { in }, _out { out }, _bytes_per_out_sample { av_get_bytes_per_sample(_out.sample_format) } {
+            , _in { in }, _out { out } {
             ASSERT(_swr);
             ASSERT(swr_init(_swr) == 0);
         }
@@ -372,7 +380,7 @@ namespace ffmpeg {
         int64_t context::convert(char** in, int64_t in_frames, char** out, int64_t out_frames) const {
             return swr_convert(_swr,
                 reinterpret_cast<uint8_t**>(out),
-                utils::narrow<int>(out_frames * _bytes_per_out_sample),
+                utils::narrow<int>(out_frames),
                 const_cast<const uint8_t**>(reinterpret_cast<uint8_t**>(in)),
                 utils::narrow<int>(in_frames));
         }
@@ -128,6 +128,9 @@ namespace ffmpeg {
             int read_frame(packet& pkt, int index) const;
 
             bool seek(std::chrono::nanoseconds pos, int index);
+
+            // Seek to a byte offset in the input
+            bool seek_byte(int64_t offset, int index);
         };
     }
 
@@ -170,6 +173,9 @@ namespace ffmpeg {
             // Send and receive
             int decode(const packet& pkt, frame& frame) const;
 
+            // Drop any buffered state, for use after seeking
+            void flush() const;
+
             AVCodecContext* ctx() const;
             uint64_t channel_layout() const;
             uint8_t channels() const;
@@ -191,8 +197,6 @@ namespace ffmpeg {
             audio_info _in;
             audio_info _out;
 
-            int _bytes_per_out_sample;
-
             public:
             context(const audio_info& in, const audio_info& out);
             ~context();
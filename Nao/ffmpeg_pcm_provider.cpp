@@ -5,6 +5,9 @@
 #include "namespaces.h"
 
 #include "riff.h"
+#include "pcm_interleave.h"
+
+#include <array>
 
 ffmpeg_pcm_provider::ffmpeg_pcm_provider(istream_ptr s, const std::string& path)
     : pcm_provider(std::move(s)), _ctx { stream, path } {
@@ -19,48 +22,58 @@ ffmpeg_pcm_provider::ffmpeg_pcm_provider(istream_ptr s, const std::string& path)
     ASSERT(_codec_ctx.open(_codec));
 
     _fmt = samples::from_av(_codec_ctx.sample_format());
-    _channel_layout = _codec_ctx.channel_layout();
     _channels = _codec_ctx.channels();
+    _channel_layout = samples::channel_layout(_codec_ctx.channel_layout(), _channels);
 }
 
 pcm_samples ffmpeg_pcm_provider::get_samples() {
-
-    // Read at least 1 frame
-    int res;
+    uint64_t skip;
     do {
-        res = _ctx.read_frame(_packet, _stream.index());
-        if (res != 0) {
-            // EOF
-            return { _fmt, 0, _channels, _channel_layout };
-        }
+        // Read at least 1 frame
+        int res;
+        do {
+            res = _ctx.read_frame(_packet, _stream.index());
+            if (res != 0) {
+                // EOF
+                return { _fmt, 0, _channels, _channel_layout };
+            }
 
-        res = _codec_ctx.decode(_packet, _frame);
+            res = _codec_ctx.decode(_packet, _frame);
 
-        if (res != 0 && res != AVERROR(EAGAIN)) {
-            throw pcm_decode_exception("failed to decode frame " + ffmpeg::strerror(res));
-        }
+            if (res != 0 && res != AVERROR(EAGAIN)) {
+                throw pcm_decode_exception("failed to decode frame " + ffmpeg::strerror(res));
+            }
+
+            _packet.unref();
+        } while (res == AVERROR(EAGAIN));
+
+        // Drop samples before the seek target
+        skip = std::min<uint64_t>(_discard, _frame.samples());
+        _discard -= skip;
+    } while (skip > 0 && skip == _frame.samples());
+
+    const uint64_t frames = _frame.samples() - skip;
 
-        _packet.unref();
-    } while (res == AVERROR(EAGAIN));
+    pcm_samples samples { buffers, _fmt, frames, _channels, _channel_layout };
 
-    pcm_samples samples { _fmt, _frame.samples(), _channels, _channel_layout };
+    _samples_played += frames;
 
-    _samples_played += _frame.samples();
+    const size_t sample_size = av_get_bytes_per_sample(samples::to_av(_fmt));
 
     if (samples::is_planar(_fmt)) {
         // Interleave planar data
-        const size_t sample_size = av_get_bytes_per_sample(samples::to_av(_fmt));
-        char* dest = samples.data();
-        for (uint64_t i = 0; i < _frame.samples(); ++i) {
-            for (uint8_t j = 0; j < _channels; ++j) {
-                std::copy_n(_frame[j] + sample_size * i, sample_size, dest);
-                dest += sample_size;
-            }
+        std::array<const char*, AV_NUM_DATA_POINTERS> planes;
+        ASSERT(_channels <= planes.size());
+
+        for (uint8_t j = 0; j < _channels; ++j) {
+            planes[j] = _frame[j] + (skip * sample_size);
         }
 
+        samples::interleave(planes.data(), _fmt, _channels, frames, samples.data());
+
     } else {
         // Or just straight copy
-        samples.fill_n(_frame.data(), samples.bytes());
+        samples.fill_n(_frame.data() + (skip * sample_size * _channels), samples.bytes());
     }
 
     return samples;
@@ -74,6 +87,10 @@ int64_t ffmpeg_pcm_provider::channels() {
     return _codec_ctx.channels();
 }
 
+uint64_t ffmpeg_pcm_provider::channel_layout() {
+    return _channel_layout;
+}
+
 std::string ffmpeg_pcm_provider::name() {
     return _codec.long_name();
 }
@@ -84,11 +101,12 @@ std::chrono::nanoseconds ffmpeg_pcm_provider::duration() {
 
 std::chrono::nanoseconds ffmpeg_pcm_provider::pos() {
     // Offset to start of data segment
-    return _samples_played * std::chrono::nanoseconds { static_cast<int64_t>((1. / _stream.sample_rate()) * 1e9) };
+    return std::chrono::nanoseconds { _samples_played * 1'000'000'000 / _stream.sample_rate() };
 }
 
 void ffmpeg_pcm_provider::seek(std::chrono::nanoseconds pos) {
-    _samples_played = pos / std::chrono::nanoseconds { static_cast<int64_t>((1. / _stream.sample_rate()) * 1e9) };
+    _samples_played = pos.count() * _stream.sample_rate() / 1'000'000'000;
+    _discard = 0;
 
     ASSERT(_ctx.seek(pos, _stream.index()));
 }
@@ -96,3 +114,13 @@ void ffmpeg_pcm_provider::seek(std::chrono::nanoseconds pos) {
 sample_format ffmpeg_pcm_provider::format() {
     return _fmt;
 }
+
+void ffmpeg_pcm_provider::seek_byte(std::streamoff offset, int64_t first_sample, int64_t target_sample) {
+    ASSERT(first_sample <= target_sample);
+    ASSERT(_ctx.seek_byte(offset, _stream.index()));
+
+    _codec_ctx.flush();
+
+    _samples_played = target_sample;
+    _discard = target_sample - first_sample;
+}
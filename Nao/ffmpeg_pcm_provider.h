@@ -7,6 +7,9 @@
 class ffmpeg_pcm_provider : public pcm_provider {
     int64_t _samples_played = 0;
 
+    // Decoded samples to drop before returning data, after a sample-accurate seek
+    int64_t _discard = 0;
+
     ffmpeg::avformat::context _ctx;
     ffmpeg::avformat::stream _stream;
     ffmpeg::avcodec::codec _codec;
@@ -26,6 +29,7 @@ class ffmpeg_pcm_provider : public pcm_provider {
     pcm_samples get_samples() override;
     int64_t rate() override;
     int64_t channels() override;
+    uint64_t channel_layout() override;
     std::string name() override;
 
     std::chrono::nanoseconds duration() override;
@@ -33,4 +37,8 @@ class ffmpeg_pcm_provider : public pcm_provider {
     void seek(std::chrono::nanoseconds pos) override;
 
     sample_format format() override;
+
+    protected:
+    // Seek to a byte offset at which decoding resumes with first_sample, then decode up to target_sample
+    void seek_byte(std::streamoff offset, int64_t first_sample, int64_t target_sample);
 };
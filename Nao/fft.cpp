@@ -0,0 +1,161 @@
+#include "fft.h"
+
+#include "utils.h"
+
+#include <emmintrin.h>
+
+#include <bit>
+#include <numbers>
+#include <cmath>
+
+real_fft::real_fft(size_t size) : _size { size } {
+    ASSERT(size >= 16 && std::has_single_bit(size));
+
+    const size_t half = size / 2;
+    const auto bits = static_cast<uint32_t>(std::countr_zero(half));
+
+    _reverse.resize(half);
+    for (size_t i = 0; i < half; ++i) {
+        uint32_t rev = 0;
+        for (uint32_t bit = 0; bit < bits; ++bit) {
+            rev |= ((i >> bit) & 1) << (bits - 1 - bit);
+        }
+
+        _reverse[i] = rev;
+    }
+
+    _twiddle_re.resize(half);
+    _twiddle_im.resize(half);
+    for (size_t span = 1; span < half; span *= 2) {
+        for (size_t j = 0; j < span; ++j) {
+            const double angle = -std::numbers::pi * static_cast<double>(j) / static_cast<double>(span);
+            _twiddle_re[span - 1 + j] = static_cast<float>(std::cos(angle));
+            _twiddle_im[span - 1 + j] = static_cast<float>(std::sin(angle));
+        }
+    }
+
+    _post_re.resize((half / 2) + 1);
+    _post_im.resize((half / 2) + 1);
+    for (size_t k = 0; k < _post_re.size(); ++k) {
+        const double angle = -2. * std::numbers::pi * static_cast<double>(k) / static_cast<double>(size);
+        _post_re[k] = static_cast<float>(std::cos(angle));
+        _post_im[k] = static_cast<float>(std::sin(angle));
+    }
+}
+
+size_t real_fft::size() const {
+    return _size;
+}
+
+size_t real_fft::bins() const {
+    return (_size / 2) + 1;
+}
+
+void real_fft::transform(const float* in, float* re, float* im) const {
+    const size_t half = _size / 2;
+
+    // Even samples are the real part and odd ones the imaginary part of a half size complex signal
+    for (size_t i = 0; i < half; ++i) {
+        re[_reverse[i]] = in[i * 2];
+        im[_reverse[i]] = in[(i * 2) + 1];
+    }
+
+    // First two stages have too few butterflies per block for vectors
+    for (size_t span = 1; span < 4 && span < half; span *= 2) {
+        for (size_t start = 0; start < half; start += span * 2) {
+            for (size_t j = 0; j < span; ++j) {
+                const float wr = _twiddle_re[span - 1 + j];
+                const float wi = _twiddle_im[span - 1 + j];
+
+                const size_t a = start + j;
+                const size_t b = a + span;
+
+                const float tr = (re[b] * wr) - (im[b] * wi);
+                const float ti = (re[b] * wi) + (im[b] * wr);
+
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+
+    for (size_t span = 4; span < half; span *= 2) {
+        const float* twr = _twiddle_re.data() + span - 1;
+        const float* twi = _twiddle_im.data() + span - 1;
+
+        for (size_t start = 0; start < half; start += span * 2) {
+            float* ar = re + start;
+            float* ai = im + start;
+            float* br = ar + span;
+            float* bi = ai + span;
+
+            for (size_t j = 0; j < span; j += 4) {
+                const __m128 wr = _mm_loadu_ps(twr + j);
+                const __m128 wi = _mm_loadu_ps(twi + j);
+
+                const __m128 xr = _mm_loadu_ps(br + j);
+                const __m128 xi = _mm_loadu_ps(bi + j);
+
+                const __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, wr), _mm_mul_ps(xi, wi));
+                const __m128 ti = _mm_add_ps(_mm_mul_ps(xr, wi), _mm_mul_ps(xi, wr));
+
+                const __m128 yr = _mm_loadu_ps(ar + j);
+                const __m128 yi = _mm_loadu_ps(ai + j);
+
+                _mm_storeu_ps(br + j, _mm_sub_ps(yr, tr));
+                _mm_storeu_ps(bi + j, _mm_sub_ps(yi, ti));
+                _mm_storeu_ps(ar + j, _mm_add_ps(yr, tr));
+                _mm_storeu_ps(ai + j, _mm_add_ps(yi, ti));
+            }
+        }
+    }
+
+    // Split into the even and odd spectra, and combine them into bins k and half - k at once
+    const float dc_re = re[0];
+    const float dc_im = im[0];
+
+    for (size_t k = 1; k <= half / 2; ++k) {
+        const size_t j = half - k;
+
+        const float even_re = (re[k] + re[j]) * .5f;
+        const float even_im = (im[k] - im[j]) * .5f;
+        const float odd_re = (im[k] + im[j]) * .5f;
+        const float odd_im = (re[j] - re[k]) * .5f;
+
+        const float tr = (odd_re * _post_re[k]) - (odd_im * _post_im[k]);
+        const float ti = (odd_re * _post_im[k]) + (odd_im * _post_re[k]);
+
+        re[k] = even_re + tr;
+        im[k] = even_im + ti;
+
+        if (j != k) {
+            re[j] = even_re - tr;
+            im[j] = ti - even_im;
+        }
+    }
+
+    re[0] = dc_re + dc_im;
+    im[0] = 0;
+    re[half] = dc_re - dc_im;
+    im[half] = 0;
+}
+
+void real_fft::power(const float* in, float* out, float* re, float* im) const {
+    transform(in, re, im);
+
+    const size_t count = bins();
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 r = _mm_loadu_ps(re + i);
+        const __m128 m = _mm_loadu_ps(im + i);
+
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(m, m)));
+    }
+
+    for (; i < count; ++i) {
+        out[i] = (re[i] * re[i]) + (im[i] * im[i]);
+    }
+}
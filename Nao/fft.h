@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Real-input FFT of a power-of-two size, computed as a complex FFT of half the size.
+// Immutable after construction, so one instance can be shared by any number of threads.
+class real_fft {
+    size_t _size;
+
+    // Bit reversed index of every complex input
+    std::vector<uint32_t> _reverse;
+
+    // Butterfly twiddles, those of the stage with half span h start at index h - 1
+    std::vector<float> _twiddle_re;
+    std::vector<float> _twiddle_im;
+
+    // Twiddles used to split the half-size result into the real spectrum
+    std::vector<float> _post_re;
+    std::vector<float> _post_im;
+
+    public:
+    // size is a power of two of at least 16
+    explicit real_fft(size_t size);
+
+    size_t size() const;
+
+    // Number of output bins, DC to Nyquist
+    size_t bins() const;
+
+    // Spectrum of size real samples into bins() values each of re and im
+    void transform(const float* in, float* re, float* im) const;
+
+    // Squared magnitude of every bin, re and im are scratch of bins() values each
+    void power(const float* in, float* out, float* re, float* im) const;
+};
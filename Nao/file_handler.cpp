@@ -31,6 +31,19 @@ const std::vector<item_data>& item_file_handler::data() const {
     return items;
 }
 
+pcm_metadata pcm_file_handler::probe() {
+    pcm_provider_ptr provider = make_provider();
+
+    return {
+        .codec = provider->name(),
+        .rate = provider->rate(),
+        .channels = provider->channels(),
+        .duration = provider->duration(),
+        .loop_start = 0,
+        .loop_end = 0
+    };
+}
+
 file_handler_tag operator|(file_handler_tag left, file_handler_tag right) noexcept {
     return static_cast<file_handler_tag>(static_cast<uintmax_t>(left) | static_cast<uintmax_t>(right));
 }
@@ -96,12 +96,26 @@ class item_file_handler : public virtual file_handler {
 
 using item_file_handler_ptr = std::shared_ptr<item_file_handler>;
 
+struct pcm_metadata {
+    std::string codec;
+    int64_t rate;
+    int64_t channels;
+    std::chrono::nanoseconds duration;
+
+    // In samples, both 0 if there is no loop
+    int64_t loop_start;
+    int64_t loop_end;
+};
+
 class pcm_file_handler : public virtual file_handler {
     public:
     using file_handler::file_handler;
     virtual ~pcm_file_handler() = default;
 
     virtual pcm_provider_ptr make_provider() = 0;
+
+    // Stream properties, by default this opens a full provider
+    virtual pcm_metadata probe();
 };
 
 using pcm_file_handler_ptr = std::shared_ptr<pcm_file_handler>;
@@ -174,5 +174,55 @@ namespace fs_utils {
         drive_list::array_type::const_iterator drive_list::end() const {
             return _drive_info.end();
         }
+
+        mapped_file::mapped_file(const std::filesystem::path& path) {
+            _file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+            if (_file == INVALID_HANDLE_VALUE) {
+                return;
+            }
+
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0) {
+                return;
+            }
+
+            _mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!_mapping) {
+                return;
+            }
+
+            _data = static_cast<const unsigned char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+            if (_data) {
+                _size = static_cast<size_t>(size.QuadPart);
+            }
+        }
+
+        mapped_file::~mapped_file() {
+            if (_data) {
+                UnmapViewOfFile(_data);
+            }
+
+            if (_mapping) {
+                CloseHandle(_mapping);
+            }
+
+            if (_file != INVALID_HANDLE_VALUE) {
+                CloseHandle(_file);
+            }
+        }
+
+        mapped_file::operator bool() const {
+            return _data != nullptr;
+        }
+
+        const unsigned char* mapped_file::data() const {
+            return _data;
+        }
+
+        size_t mapped_file::size() const {
+            return _size;
+        }
     }
 }
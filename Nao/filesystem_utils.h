@@ -69,5 +69,27 @@ namespace fs_utils {
             array_type::iterator end();
             array_type::const_iterator end() const;
         };
+
+        // Read-only memory mapping of an entire file
+        class mapped_file {
+            HANDLE _file = INVALID_HANDLE_VALUE;
+            HANDLE _mapping = nullptr;
+
+            const unsigned char* _data = nullptr;
+            size_t _size = 0;
+
+            public:
+            explicit mapped_file(const std::filesystem::path& path);
+            ~mapped_file();
+
+            mapped_file(const mapped_file&) = delete;
+            mapped_file& operator=(const mapped_file&) = delete;
+
+            // False if the file could not be opened or is empty
+            operator bool() const;
+
+            const unsigned char* data() const;
+            size_t size() const;
+        };
     }
 }
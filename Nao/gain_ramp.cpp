@@ -0,0 +1,86 @@
+#include "gain_ramp.h"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace detail {
+    // Full scale float to int16
+    static constexpr float s16_scale = 32768.f;
+
+    // Clamped before converting, lrint of anything outside long is undefined. NaN ends up at the minimum.
+    static int16_t to_s16(float val) {
+        val = (val > -32768.f) ? std::min(val, 32767.f) : -32768.f;
+        return static_cast<int16_t>(std::lrint(val));
+    }
+
+    // Constant gain, 8 samples at a time
+    static void scale_s16(const float* in, size_t count, float gain, int16_t* out) {
+        const float scale = gain * s16_scale;
+        const __m128 vscale = _mm_set1_ps(scale);
+        const __m128 min = _mm_set1_ps(-32768.f);
+        const __m128 max = _mm_set1_ps(32767.f);
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            // Clamped first, out of range values would convert to 0x80000000 and pack to -32768
+            __m128 lo = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i), vscale), min), max);
+            __m128 hi = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), vscale), min), max);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+        }
+
+        for (; i < count; ++i) {
+            out[i] = to_s16(in[i] * scale);
+        }
+    }
+}
+
+gain_ramp::gain_ramp(float gain, int64_t ramp_frames)
+    : _current { gain }, _target { gain }, _ramp_frames { std::max<int64_t>(ramp_frames, 1) } {
+
+}
+
+void gain_ramp::set(float target) {
+    if (target == _target) {
+        return;
+    }
+
+    _target = target;
+    _remaining = _ramp_frames;
+    _step = (_target - _current) / static_cast<float>(_ramp_frames);
+}
+
+float gain_ramp::current() const {
+    return _current;
+}
+
+bool gain_ramp::ramping() const {
+    return _remaining > 0;
+}
+
+void gain_ramp::apply(const float* in, size_t channels, size_t frames, int16_t* out) {
+    // Ramps are short, so they're done per frame
+    while (_remaining > 0 && frames > 0) {
+        _current += _step;
+
+        if (--_remaining == 0) {
+            // No rounding error left over
+            _current = _target;
+        }
+
+        const float scale = _current * detail::s16_scale;
+        for (size_t c = 0; c < channels; ++c) {
+            out[c] = detail::to_s16(in[c] * scale);
+        }
+
+        in += channels;
+        out += channels;
+        --frames;
+    }
+
+    if (frames > 0) {
+        detail::scale_s16(in, frames * channels, _current, out);
+    }
+}
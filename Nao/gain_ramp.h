@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Volume that moves to a new value over a short ramp instead of jumping to it, which would be audible as zipper noise
+class gain_ramp {
+    float _current;
+    float _target;
+
+    // Change per frame while ramping
+    float _step = 0.f;
+    int64_t _remaining = 0;
+
+    int64_t _ramp_frames;
+
+    public:
+    explicit gain_ramp(float gain = 1.f, int64_t ramp_frames = 480);
+
+    // Start ramping towards a new gain, does nothing if it's already the target
+    void set(float target);
+
+    float current() const;
+    bool ramping() const;
+
+    // Scale interleaved float samples and convert them to int16, saturating instead of wrapping
+    void apply(const float* in, size_t channels, size_t frames, int16_t* out);
+};
@@ -0,0 +1,414 @@
+#include "loudness.h"
+
+#include "pcm_reader.h"
+#include "utils.h"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <numbers>
+#include <numeric>
+#include <cmath>
+
+namespace detail {
+    // WAVEFORMATEXTENSIBLE speaker bits with a weight other than 1
+    enum speaker : uint64_t {
+        low_frequency = 0x8,
+        back_left     = 0x10,
+        back_right    = 0x20,
+        side_left     = 0x200,
+        side_right    = 0x400
+    };
+
+    // +1.5 dB for surround channels
+    static constexpr double surround_weight = 1.41;
+
+    // Gating block of 400 ms and short-term window of 3 s, in 100 ms sub-blocks
+    static constexpr size_t momentary_blocks = 4;
+    static constexpr size_t short_term_blocks = 30;
+
+    static constexpr double absolute_gate = -70.;
+    static constexpr double integrated_gate = -10.;
+    static constexpr double range_gate = -20.;
+
+    // Keeps the filter state away from denormals on digital silence, far below anything audible
+    static constexpr double denormal_guard = 1e-20;
+
+    // Frames decoded per read
+    static constexpr int64_t block_frames = 4096;
+
+    static double to_lufs(double energy) {
+        return -0.691 + (10. * std::log10(energy));
+    }
+
+    static double to_db(float peak) {
+        return 20. * std::log10(static_cast<double>(peak));
+    }
+
+    static double bessel_i0(double x) {
+        double sum = 1.;
+        double term = 1.;
+
+        for (int k = 1; k < 50; ++k) {
+            term *= (x / (2. * k)) * (x / (2. * k));
+            sum += term;
+
+            if (term < (sum * 1e-12)) {
+                break;
+            }
+        }
+
+        return sum;
+    }
+
+    // Mean energy of every run of count consecutive sub-blocks, one per sub-block step
+    static std::vector<double> windows(const std::vector<double>& energy, size_t count) {
+        std::vector<double> result;
+        if (energy.size() < count) {
+            return result;
+        }
+
+        double sum = std::accumulate(energy.begin(), energy.begin() + static_cast<ptrdiff_t>(count), 0.);
+        result.push_back(sum / static_cast<double>(count));
+
+        for (size_t i = count; i < energy.size(); ++i) {
+            sum += energy[i] - energy[i - count];
+            result.push_back(std::max(sum, 0.) / static_cast<double>(count));
+        }
+
+        return result;
+    }
+
+    // Blocks louder than the absolute gate, and the mean energy of them
+    static std::vector<double> gate(const std::vector<double>& blocks, double& mean) {
+        std::vector<double> result;
+        std::copy_if(blocks.begin(), blocks.end(), std::back_inserter(result),
+            [](double energy) { return energy > 0. && to_lufs(energy) > absolute_gate; });
+
+        mean = result.empty() ? 0. : std::accumulate(result.begin(), result.end(), 0.) / static_cast<double>(result.size());
+        return result;
+    }
+}
+
+loudness_meter::loudness_meter(int64_t rate, size_t channels, uint64_t layout)
+    : _rate { rate }, _channels { channels }
+    , _sub_frames { static_cast<size_t>(rate / 10) }
+    , _oversample { rate < 96000 ? 4u : (rate < 192000 ? 2u : 1u) }
+    , _history(channels, std::vector<float>(peak_taps - 1, 0.f)) {
+    ASSERT(rate >= 10 && channels > 0);
+
+    const size_t pairs = (channels + 1) / 2;
+
+    // Channels appear in the order of their speaker bits, unknown ones count as front
+    _weights.assign(pairs * 2, 0.);
+    size_t index = 0;
+
+    for (uint64_t bit = 1; bit != 0 && index < channels; bit <<= 1) {
+        if (layout & bit) {
+            switch (bit) {
+                case detail::low_frequency: _weights[index] = 0.; break;
+                case detail::back_left:
+                case detail::back_right:
+                case detail::side_left:
+                case detail::side_right:    _weights[index] = detail::surround_weight; break;
+                default:                    _weights[index] = 1.; break;
+            }
+
+            ++index;
+        }
+    }
+
+    std::fill(_weights.begin() + static_cast<ptrdiff_t>(index), _weights.begin() + static_cast<ptrdiff_t>(channels), 1.);
+
+    // BS.1770 pre-filter and RLB curve, recomputed for the rate as in the reference 48 kHz coefficients
+    const double rate_d = static_cast<double>(rate);
+    {
+        const double f0 = 1681.974450955533;
+        const double gain = 3.999843853973347;
+        const double q = 0.7071752369554196;
+
+        const double k = std::tan(std::numbers::pi * f0 / rate_d);
+        const double vh = std::pow(10., gain / 20.);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1. + (k / q) + (k * k);
+
+        _shelf = {
+            (vh + (vb * k / q) + (k * k)) / a0,
+            2. * ((k * k) - vh) / a0,
+            (vh - (vb * k / q) + (k * k)) / a0,
+            2. * ((k * k) - 1.) / a0,
+            (1. - (k / q) + (k * k)) / a0
+        };
+    }
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+
+        const double k = std::tan(std::numbers::pi * f0 / rate_d);
+        const double a0 = 1. + (k / q) + (k * k);
+
+        _highpass = {
+            1.,
+            -2.,
+            1.,
+            2. * ((k * k) - 1.) / a0,
+            (1. - (k / q) + (k * k)) / a0
+        };
+    }
+
+    _state.assign(pairs * 8, 0.);
+
+    // Kaiser windowed sinc at the oversampled rate, every phase summing to about 1
+    if (_oversample > 1) {
+        const size_t length = peak_taps * _oversample;
+        const double centre = static_cast<double>(length - 1) / 2.;
+        const double beta = 7.;
+
+        _taps.resize(length);
+        for (size_t p = 0; p < _oversample; ++p) {
+            for (size_t k = 0; k < peak_taps; ++k) {
+                const double t = (static_cast<double>((k * _oversample) + p) - centre) / static_cast<double>(_oversample);
+                const double w = (static_cast<double>((k * _oversample) + p) - centre) / (centre + 1.);
+
+                const double sinc = (t == 0.) ? 1. : std::sin(std::numbers::pi * t) / (std::numbers::pi * t);
+                const double window = detail::bessel_i0(beta * std::sqrt(1. - (w * w))) / detail::bessel_i0(beta);
+
+                _taps[(p * peak_taps) + k] = static_cast<float>(sinc * window);
+            }
+        }
+    }
+}
+
+void loudness_meter::process(const float* planes, size_t stride, size_t frames) {
+    for (size_t done = 0; done < frames;) {
+        // Up to the end of the current sub-block
+        const size_t count = std::min(frames - done, _sub_frames - _sub_pos);
+
+        _weigh(planes + done, stride, count);
+
+        _sub_pos += count;
+        done += count;
+
+        if (_sub_pos == _sub_frames) {
+            _energy.push_back(_sub_sum / static_cast<double>(_sub_frames));
+
+            _sub_pos = 0;
+            _sub_sum = 0.;
+        }
+    }
+
+    for (size_t c = 0; c < _channels; ++c) {
+        _peak(planes + (c * stride), frames, c);
+    }
+
+    _frames += static_cast<int64_t>(frames);
+}
+
+loudness_meter::result loudness_meter::finish() const {
+    constexpr double inf = std::numeric_limits<double>::infinity();
+
+    result res {
+        .integrated = -inf,
+        .range = 0.,
+        .true_peak = (_true_peak > 0.f) ? detail::to_db(_true_peak) : -inf,
+        .sample_peak = (_sample_peak > 0.f) ? detail::to_db(_sample_peak) : -inf,
+        .frames = _frames
+    };
+
+    // Integrated, gated at -70 LUFS and then 10 LU below the mean of what is left
+    double mean = 0.;
+    const std::vector<double> blocks = detail::gate(detail::windows(_energy, detail::momentary_blocks), mean);
+
+    if (!blocks.empty()) {
+        const double threshold = detail::to_lufs(mean) + detail::integrated_gate;
+
+        double sum = 0.;
+        size_t count = 0;
+
+        for (double energy : blocks) {
+            if (detail::to_lufs(energy) > threshold) {
+                sum += energy;
+                ++count;
+            }
+        }
+
+        if (count > 0) {
+            res.integrated = detail::to_lufs(sum / static_cast<double>(count));
+        }
+    }
+
+    // Range, spread between the 10th and 95th percentile of short-term loudness gated 20 LU below the mean
+    const std::vector<double> short_term = detail::gate(detail::windows(_energy, detail::short_term_blocks), mean);
+
+    if (!short_term.empty()) {
+        const double threshold = detail::to_lufs(mean) + detail::range_gate;
+
+        std::vector<double> levels;
+        for (double energy : short_term) {
+            if (const double level = detail::to_lufs(energy); level > threshold) {
+                levels.push_back(level);
+            }
+        }
+
+        if (!levels.empty()) {
+            std::sort(levels.begin(), levels.end());
+
+            const auto percentile = [&](double p) {
+                return levels[static_cast<size_t>(std::lround(p * static_cast<double>(levels.size() - 1)))];
+            };
+
+            res.range = percentile(.95) - percentile(.1);
+        }
+    }
+
+    return res;
+}
+
+std::optional<loudness_meter::result> loudness_meter::measure(const pcm_provider_ptr& provider, const std::atomic<bool>* cancel) {
+    pcm_reader reader { provider };
+
+    const auto channels = static_cast<size_t>(provider->channels());
+    loudness_meter meter { provider->rate(), channels, provider->channel_layout() };
+
+    std::vector<float> buf(detail::block_frames * channels);
+
+    while (true) {
+        if (cancel && *cancel) {
+            return std::nullopt;
+        }
+
+        // Planes are block_frames long, however many frames were read
+        const int64_t frames = reader.read(std::as_writable_bytes(std::span { buf }), sample_format::float32p, detail::block_frames);
+        meter.process(buf.data(), detail::block_frames, static_cast<size_t>(frames));
+
+        if (frames < detail::block_frames) {
+            break;
+        }
+    }
+
+    return meter.finish();
+}
+
+void loudness_meter::_weigh(const float* planes, size_t stride, size_t frames) {
+    const __m128d shelf_b0 = _mm_set1_pd(_shelf[0]);
+    const __m128d shelf_b1 = _mm_set1_pd(_shelf[1]);
+    const __m128d shelf_b2 = _mm_set1_pd(_shelf[2]);
+    const __m128d shelf_a1 = _mm_set1_pd(_shelf[3]);
+    const __m128d shelf_a2 = _mm_set1_pd(_shelf[4]);
+
+    const __m128d hp_a1 = _mm_set1_pd(_highpass[3]);
+    const __m128d hp_a2 = _mm_set1_pd(_highpass[4]);
+
+    const __m128d guard = _mm_set1_pd(detail::denormal_guard);
+
+    // Two channels per vector, the filters only run along time
+    for (size_t c = 0; c < _channels; c += 2) {
+        const float* left = planes + (c * stride);
+        // A lone last channel fills both lanes, the second one has no weight
+        const float* right = ((c + 1) < _channels) ? planes + ((c + 1) * stride) : left;
+
+        double* state = _state.data() + (c * 4);
+        __m128d s1 = _mm_loadu_pd(state);
+        __m128d s2 = _mm_loadu_pd(state + 2);
+        __m128d s3 = _mm_loadu_pd(state + 4);
+        __m128d s4 = _mm_loadu_pd(state + 6);
+
+        const __m128d weight = _mm_loadu_pd(_weights.data() + c);
+        __m128d sum = _mm_setzero_pd();
+
+        for (size_t i = 0; i < frames; ++i) {
+            const __m128d x = _mm_add_pd(_mm_set_pd(right[i], left[i]), guard);
+
+            // Transposed direct form II, high shelf
+            const __m128d y = _mm_add_pd(_mm_mul_pd(shelf_b0, x), s1);
+            s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(shelf_b1, x), _mm_mul_pd(shelf_a1, y)), s2);
+            s2 = _mm_sub_pd(_mm_mul_pd(shelf_b2, x), _mm_mul_pd(shelf_a2, y));
+
+            // High pass, b is 1 -2 1
+            const __m128d z = _mm_add_pd(y, s3);
+            s3 = _mm_sub_pd(_mm_sub_pd(s4, _mm_add_pd(y, y)), _mm_mul_pd(hp_a1, z));
+            s4 = _mm_sub_pd(y, _mm_mul_pd(hp_a2, z));
+
+            sum = _mm_add_pd(sum, _mm_mul_pd(weight, _mm_mul_pd(z, z)));
+        }
+
+        _mm_storeu_pd(state, s1);
+        _mm_storeu_pd(state + 2, s2);
+        _mm_storeu_pd(state + 4, s3);
+        _mm_storeu_pd(state + 6, s4);
+
+        alignas(16) double lanes[2];
+        _mm_store_pd(lanes, sum);
+        _sub_sum += lanes[0] + lanes[1];
+    }
+}
+
+void loudness_meter::_peak(const float* samples, size_t frames, size_t channel) {
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+    __m128 sample_max = _mm_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        sample_max = _mm_max_ps(sample_max, _mm_and_ps(_mm_loadu_ps(samples + i), abs_mask));
+    }
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, sample_max);
+    float peak = std::max({ lanes[0], lanes[1], lanes[2], lanes[3] });
+
+    for (; i < frames; ++i) {
+        peak = std::max(peak, std::abs(samples[i]));
+    }
+
+    _sample_peak = std::max(_sample_peak, peak);
+
+    if (_oversample == 1) {
+        _true_peak = std::max(_true_peak, peak);
+        return;
+    }
+
+    // History followed by the new samples, so output n reads inputs n - peak_taps + 1 to n
+    std::vector<float>& history = _history[channel];
+    history.resize(peak_taps - 1);
+    history.insert(history.end(), samples, samples + frames);
+
+    const float* in = history.data() + (peak_taps - 1);
+    __m128 true_max = _mm_setzero_ps();
+
+    // Four outputs of one phase at a time, so no horizontal sums are needed
+    size_t n = 0;
+    for (; n + 4 <= frames; n += 4) {
+        for (size_t p = 0; p < _oversample; ++p) {
+            const float* taps = _taps.data() + (p * peak_taps);
+            __m128 acc = _mm_setzero_ps();
+
+            for (size_t k = 0; k < peak_taps; ++k) {
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(taps[k]), _mm_loadu_ps(in + n - k)));
+            }
+
+            true_max = _mm_max_ps(true_max, _mm_and_ps(acc, abs_mask));
+        }
+    }
+
+    _mm_store_ps(lanes, true_max);
+    float true_peak = std::max({ lanes[0], lanes[1], lanes[2], lanes[3] });
+
+    for (; n < frames; ++n) {
+        for (size_t p = 0; p < _oversample; ++p) {
+            const float* taps = _taps.data() + (p * peak_taps);
+
+            float acc = 0.f;
+            for (size_t k = 0; k < peak_taps; ++k) {
+                acc += taps[k] * in[n - k];
+            }
+
+            true_peak = std::max(true_peak, std::abs(acc));
+        }
+    }
+
+    // Never below the samples themselves
+    _true_peak = std::max({ _true_peak, true_peak, peak });
+
+    history.erase(history.begin(), history.end() - static_cast<ptrdiff_t>(peak_taps - 1));
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "pcm_provider.h"
+
+#include <array>
+#include <optional>
+#include <atomic>
+
+// Loudness per ITU-R BS.1770-4 and EBU R128 (Tech 3341/3342) for one stream
+class loudness_meter {
+    public:
+    struct result {
+        // LUFS, -inf if every block is below the absolute gate
+        double integrated;
+
+        // Loudness range, LU
+        double range;
+
+        // dBTP and dBFS, -inf for digital silence
+        double true_peak;
+        double sample_peak;
+
+        int64_t frames;
+    };
+
+    // Taps of every oversampling phase of the true peak filter
+    static constexpr size_t peak_taps = 12;
+
+    private:
+    int64_t _rate;
+    size_t _channels;
+
+    // BS.1770 channel weights, in pairs of lanes
+    std::vector<double> _weights;
+
+    // K-weighting high shelf and high pass, b0 b1 b2 a1 a2
+    std::array<double, 5> _shelf;
+    std::array<double, 5> _highpass;
+
+    // Filter state, 4 values of 2 lanes per pair of channels
+    std::vector<double> _state;
+
+    // Mean square of every finished 100 ms sub-block
+    std::vector<double> _energy;
+
+    size_t _sub_frames;
+    size_t _sub_pos = 0;
+    double _sub_sum = 0.;
+
+    // Polyphase interpolator, taps of phase p at p * peak_taps
+    size_t _oversample;
+    std::vector<float> _taps;
+
+    // Last peak_taps - 1 samples of every channel, and room for the block after them
+    std::vector<std::vector<float>> _history;
+
+    float _true_peak = 0.f;
+    float _sample_peak = 0.f;
+
+    int64_t _frames = 0;
+
+    public:
+    // layout is the channel mask, used to weight surround channels and skip LFE
+    loudness_meter(int64_t rate, size_t channels, uint64_t layout);
+
+    // Planar float samples, channel c starting at planes + c * stride
+    void process(const float* planes, size_t stride, size_t frames);
+
+    result finish() const;
+
+    // Decode the whole provider, returns nothing if cancelled
+    static std::optional<result> measure(const pcm_provider_ptr& provider, const std::atomic<bool>* cancel = nullptr);
+
+    private:
+    void _weigh(const float* planes, size_t stride, size_t frames);
+    void _peak(const float* samples, size_t frames, size_t channel);
+};
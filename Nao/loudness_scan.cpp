@@ -0,0 +1,281 @@
+#include "loudness_scan.h"
+
+#include "file_handler_factory.h"
+#include "filesystem_handler.h"
+#include "vector_streambuf.h"
+
+#include <nao/logging.h>
+
+#include <fstream>
+#include <iomanip>
+
+namespace detail {
+    // Items waiting for a worker, per worker, so the walk doesn't run far ahead of decoding
+    static constexpr size_t items_per_thread = 2;
+
+    // Items in containers share the container's stream, which can't be read from several threads
+    static istream_ptr private_copy(const istream_ptr& stream) {
+        static constexpr std::streamsize chunk = 65536;
+
+        // Read to the end, not every streambuf can seek from it
+        std::vector<std::byte> data;
+        stream->seekg(0);
+
+        while (true) {
+            const size_t offset = data.size();
+            data.resize(offset + chunk);
+
+            stream->read(data.data() + offset, chunk);
+            data.resize(offset + static_cast<size_t>(stream->gcount()));
+
+            if (stream->gcount() < chunk) {
+                break;
+            }
+        }
+
+        stream->clear();
+
+        return std::make_shared<binary_istream>(std::make_unique<vector_streambuf>(std::move(data)));
+    }
+
+    static std::string csv_field(const std::string& str) {
+        if (str.find_first_of(",\"\r\n") == std::string::npos) {
+            return str;
+        }
+
+        std::string result = "\"";
+        for (char c : str) {
+            if (c == '"') {
+                result.push_back('"');
+            }
+
+            result.push_back(c);
+        }
+
+        result.push_back('"');
+        return result;
+    }
+
+    static std::string json_string(const std::string& str) {
+        std::stringstream ss;
+        ss << '"';
+
+        for (char c : str) {
+            switch (c) {
+                case '"':  ss << "\\\""; break;
+                case '\\': ss << "\\\\"; break;
+                case '\n': ss << "\\n"; break;
+                case '\r': ss << "\\r"; break;
+                case '\t': ss << "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+                    } else {
+                        ss << c;
+                    }
+                    break;
+            }
+        }
+
+        ss << '"';
+        return ss.str();
+    }
+
+    // Fixed to 2 decimals, inf_text for levels of silence
+    static std::string number(double val, const char* inf_text) {
+        if (!std::isfinite(val)) {
+            return inf_text;
+        }
+
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(2) << val;
+        return ss.str();
+    }
+
+    static double seconds(std::chrono::nanoseconds duration) {
+        return std::chrono::duration<double>(duration).count();
+    }
+}
+
+loudness_scan::loudness_scan(size_t threads) : _threads { threads == 0 ? thread_pool::pool_size() : threads } {
+
+}
+
+std::vector<loudness_scan::entry> loudness_scan::run(const std::string& root, const progress& done, const std::atomic<bool>* cancel) {
+    {
+        std::scoped_lock lock { _mutex };
+        _entries.clear();
+    }
+
+    file_handler_ptr handler;
+
+    std::error_code ec;
+    if (std::filesystem::is_directory(root, ec)) {
+        // Directories are handled with a trailing separator
+        std::string dir = root;
+        if (dir.back() != '\\') {
+            dir.push_back('\\');
+        }
+
+        handler = file_handler_factory::create(nullptr, dir);
+    } else {
+        handler = file_handler_factory::create(std::make_shared<binary_istream>(root), root);
+    }
+
+    if (!handler) {
+        nao::coutln("nothing to measure in", root);
+        return { };
+    }
+
+    {
+        thread_pool pool { _threads };
+
+        _walk(handler, pool, done, cancel);
+
+        std::unique_lock lock { _mutex };
+        _cv.wait(lock, [this] { return _in_flight == 0; });
+    }
+
+    std::scoped_lock lock { _mutex };
+    return std::move(_entries);
+}
+
+bool loudness_scan::write_csv(const std::filesystem::path& path, const std::vector<entry>& entries) {
+    std::ofstream out { path, std::ios::trunc };
+
+    out << "path,rate,channels,duration,integrated,range,true_peak,sample_peak,error\n";
+
+    for (const entry& e : entries) {
+        out << detail::csv_field(e.path) << ',';
+
+        if (e.error.empty()) {
+            out << e.rate << ',' << e.channels << ','
+                << detail::number(detail::seconds(e.duration), "") << ','
+                << detail::number(e.loudness.integrated, "-inf") << ','
+                << detail::number(e.loudness.range, "") << ','
+                << detail::number(e.loudness.true_peak, "-inf") << ','
+                << detail::number(e.loudness.sample_peak, "-inf") << ",\n";
+        } else {
+            out << ",,,,,,," << detail::csv_field(e.error) << '\n';
+        }
+    }
+
+    return out.good();
+}
+
+bool loudness_scan::write_json(const std::filesystem::path& path, const std::vector<entry>& entries) {
+    std::ofstream out { path, std::ios::trunc };
+
+    out << "[\n";
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const entry& e = entries[i];
+
+        out << "  { \"path\": " << detail::json_string(e.path);
+
+        if (e.error.empty()) {
+            // JSON has no infinities, silence is null
+            out << ", \"rate\": " << e.rate
+                << ", \"channels\": " << e.channels
+                << ", \"duration\": " << detail::number(detail::seconds(e.duration), "null")
+                << ", \"integrated\": " << detail::number(e.loudness.integrated, "null")
+                << ", \"range\": " << detail::number(e.loudness.range, "null")
+                << ", \"true_peak\": " << detail::number(e.loudness.true_peak, "null")
+                << ", \"sample_peak\": " << detail::number(e.loudness.sample_peak, "null");
+        } else {
+            out << ", \"error\": " << detail::json_string(e.error);
+        }
+
+        out << ((i + 1 < entries.size()) ? " },\n" : " }\n");
+    }
+
+    out << "]\n";
+
+    return out.good();
+}
+
+void loudness_scan::_walk(const file_handler_ptr& handler, thread_pool& pool, const progress& done, const std::atomic<bool>* cancel) {
+    if (cancel && *cancel) {
+        return;
+    }
+
+    if (auto pcm = file_handler::query<TAG_PCM>(handler)) {
+        size_t index;
+
+        {
+            std::unique_lock lock { _mutex };
+            _cv.wait(lock, [this] { return _in_flight < (_threads * detail::items_per_thread); });
+
+            index = _entries.size();
+            _entries.push_back({ .path = handler->get_path() });
+            ++_in_flight;
+        }
+
+        pool.push([this, index, pcm, &done, cancel] {
+            _measure(index, pcm, done, cancel);
+
+            std::scoped_lock lock { _mutex };
+            --_in_flight;
+            _cv.notify_all();
+        });
+
+        return;
+    }
+
+    auto items = file_handler::query<TAG_ITEMS>(handler);
+    if (!items) {
+        return;
+    }
+
+    for (const item_data& item : items->data()) {
+        if (cancel && *cancel) {
+            return;
+        }
+
+        const std::string path = item.path();
+
+        try {
+            istream_ptr stream = item.stream;
+            if (stream && !dynamic_cast<filesystem_handler*>(item.handler)) {
+                stream = detail::private_copy(stream);
+            }
+
+            if (file_handler_ptr child = file_handler_factory::create(stream, path)) {
+                _walk(child, pool, done, cancel);
+            }
+        } catch (const std::exception& e) {
+            nao::coutln("failed to open", path, ":", e.what());
+
+            std::scoped_lock lock { _mutex };
+            _entries.push_back({ .path = path, .error = e.what() });
+        }
+    }
+}
+
+void loudness_scan::_measure(size_t index, const pcm_file_handler_ptr& handler, const progress& done, const std::atomic<bool>* cancel) {
+    entry result { .path = handler->get_path() };
+
+    try {
+        pcm_provider_ptr provider = handler->make_provider();
+
+        result.rate = provider->rate();
+        result.channels = provider->channels();
+
+        if (auto loudness = loudness_meter::measure(provider, cancel)) {
+            result.loudness = *loudness;
+            result.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::duration<double>(static_cast<double>(loudness->frames) / static_cast<double>(result.rate)));
+        } else {
+            result.error = "cancelled";
+        }
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+
+    if (done) {
+        done(result);
+    }
+
+    std::scoped_lock lock { _mutex };
+    _entries[index] = std::move(result);
+}
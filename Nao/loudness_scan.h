@@ -0,0 +1,51 @@
+#pragma once
+
+#include "loudness.h"
+#include "file_handler.h"
+#include "thread_pool.h"
+
+#include <filesystem>
+
+// Measures every PCM item below a directory or container, decoding items in parallel
+class loudness_scan {
+    public:
+    struct entry {
+        std::string path;
+
+        int64_t rate;
+        int64_t channels;
+        std::chrono::nanoseconds duration;
+
+        loudness_meter::result loudness;
+
+        // Empty if the item was measured
+        std::string error;
+    };
+
+    // Called from worker threads as every item finishes
+    using progress = std::function<void(const entry& item)>;
+
+    private:
+    size_t _threads;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    size_t _in_flight = 0;
+
+    std::vector<entry> _entries;
+
+    public:
+    // 0 threads for one per core
+    explicit loudness_scan(size_t threads = 0);
+
+    // Walk root recursively through every item handler, and measure whatever decodes to PCM.
+    // Entries are in walk order. After a cancel, items not reached yet are left out and those cut short have an error.
+    std::vector<entry> run(const std::string& root, const progress& done = { }, const std::atomic<bool>* cancel = nullptr);
+
+    static bool write_csv(const std::filesystem::path& path, const std::vector<entry>& entries);
+    static bool write_json(const std::filesystem::path& path, const std::vector<entry>& entries);
+
+    private:
+    void _walk(const file_handler_ptr& handler, thread_pool& pool, const progress& done, const std::atomic<bool>* cancel);
+    void _measure(size_t index, const pcm_file_handler_ptr& handler, const progress& done, const std::atomic<bool>* cancel);
+};
@@ -1,13 +1,49 @@
 #include "ogg_stream.h"
 
-ogg_stream::ogg_stream(const ostream_ptr& out, int serialno) : _out { out } {
-    ogg_stream_init(&_os, serialno);
+#include <algorithm>
+#include <array>
+
+namespace detail {
+    // Slicing-by-8 tables, table[k][n] is the CRC of byte n followed by k zero bytes
+    static constexpr auto make_crc_tables() {
+        std::array<std::array<uint32_t, 256>, 8> tables { };
+
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t r = i << 24;
+            for (int j = 0; j < 8; ++j) {
+                r = (r & 0x80000000) ? ((r << 1) ^ 0x04c11db7) : (r << 1);
+            }
+
+            tables[0][i] = r;
+        }
+
+        for (size_t k = 1; k < 8; ++k) {
+            for (size_t i = 0; i < 256; ++i) {
+                uint32_t prev = tables[k - 1][i];
+                tables[k][i] = (prev << 8) ^ tables[0][prev >> 24];
+            }
+        }
+
+        return tables;
+    }
+
+    static constexpr auto crc_tables = make_crc_tables();
+
+    static void write_le(unsigned char* dest, uint64_t val, size_t bytes) {
+        for (size_t i = 0; i < bytes; ++i) {
+            dest[i] = static_cast<unsigned char>(val & 0xFF);
+            val >>= 8;
+        }
+    }
+}
+
+ogg_stream::ogg_stream(const ostream_ptr& out, int serialno, const ogg_page_policy& policy)
+    : _out { out }, _serialno { static_cast<uint32_t>(serialno) }, _policy { policy } {
+
 }
 
 ogg_stream::~ogg_stream() {
     flush();
-
-    ogg_stream_clear(&_os);
 }
 
 ogg_packet ogg_stream::packet(char* data, int64_t size, bool eos) {
@@ -28,21 +64,309 @@ ogg_packet ogg_stream::packet(char* data, int64_t size, bool eos) {
 }
 
 void ogg_stream::packetin(const ogg_packet& packet) {
-    ogg_stream_packetin(&_os, const_cast<ogg_packet*>(&packet));
+    if (_e_o_s) {
+        return;
+    }
+
+    // End the pending page first if this packet would take it past a cap
+    const bool packets_full = (_policy.max_packets > 0) && (_page_packets >= _policy.max_packets);
+    const bool span_full = (_policy.max_granules > 0) && (_page_granule >= 0)
+        && ((packet.granulepos - _page_granule) > _policy.max_granules);
+
+    if (packets_full || span_full) {
+        flush();
+    }
+
+    // Lacing values, 255 for every full segment and the remainder (possibly 0) last.
+    // The data is only referenced, pages are written straight from the caller's packet.
+    size_t full = static_cast<size_t>(packet.bytes) / 255;
+    for (size_t i = 0; i < full; ++i) {
+        _segments.push_back({ .value = 255, .begin = (i == 0), .granule = _granulepos, .borrowed = packet.packet + (i * 255), .offset = 0 });
+    }
+
+    _segments.push_back({
+        .value = static_cast<uint8_t>(packet.bytes % 255),
+        .begin = (full == 0),
+        .granule = packet.granulepos,
+        .borrowed = packet.packet + (full * 255),
+        .offset = 0
+    });
+
+    _borrowed += full + 1;
+
+    _granulepos = packet.granulepos;
+
+    if (packet.e_o_s) {
+        _e_o_s = true;
+    }
+
+    if (_page_packets++ == 0) {
+        _page_granule = packet.granulepos;
+    }
 }
 
 void ogg_stream::pageout() {
-    ogg_page page;
-    while (ogg_stream_pageout(&_os, &page)) {
-        _out->write(page.header, page.header_len);
-        _out->write(page.body, page.body_len);
+    if (_limit_reached()) {
+        // Packets or duration cap hit, end the page here
+        flush();
+        return;
+    }
+
+    int fill = (_policy.fill_bytes > 0) ? _policy.fill_bytes : default_fill;
+
+    while (true) {
+        // The last pages and the first (header only) page are always written out.
+        // Decided per page like libogg's ogg_stream_pageout, the first page clears _first_page.
+        const bool force = !_segments.empty() && (_e_o_s || _first_page);
+
+        if (!_page(force, fill)) {
+            break;
+        }
     }
+
+    _own();
 }
 
 void ogg_stream::flush() {
-    ogg_page page;
-    while (ogg_stream_flush(&_os, &page) != 0) {
-        _out->write(page.header, page.header_len);
-        _out->write(page.body, page.body_len);
+    while (_page(true, default_fill)) { }
+
+    _own();
+}
+
+const ogg_page_policy& ogg_stream::policy() const {
+    return _policy;
+}
+
+int64_t ogg_stream::packetno() const {
+    return _current_packtet;
+}
+
+int64_t ogg_stream::pageno() const {
+    return _pageno;
+}
+
+void ogg_stream::restore(int64_t packetno, int64_t pageno) {
+    // Continue the existing logical stream instead of starting a new one
+    _buf.clear();
+    _buf_begin = 0;
+    _segments.clear();
+    _borrowed = 0;
+
+    _pageno = pageno;
+    _granulepos = 0;
+    _first_page = false;
+    _e_o_s = false;
+
+    _current_packtet = packetno;
+    _b_o_s = false;
+
+    _page_packets = 0;
+    _page_granule = -1;
+}
+
+uint32_t ogg_stream::crc(uint32_t crc, const unsigned char* data, size_t size) {
+    const auto& t = detail::crc_tables;
+
+    while (size >= 8) {
+        crc ^= (uint32_t { data[0] } << 24) | (uint32_t { data[1] } << 16)
+             | (uint32_t { data[2] } << 8) | uint32_t { data[3] };
+
+        crc = t[7][crc >> 24] ^ t[6][(crc >> 16) & 0xFF] ^ t[5][(crc >> 8) & 0xFF] ^ t[4][crc & 0xFF]
+            ^ t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+
+        data += 8;
+        size -= 8;
+    }
+
+    while (size--) {
+        crc = (crc << 8) ^ t[0][((crc >> 24) ^ *data++) & 0xFF];
+    }
+
+    return crc;
+}
+
+bool ogg_stream::_limit_reached() const {
+    if (_policy.max_packets > 0 && _page_packets >= _policy.max_packets) {
+        return true;
+    }
+
+    if (_policy.max_granules > 0 && _page_granule >= 0 && !_segments.empty()) {
+        // Granule of the most recent packet is the one the page would end with
+        return (_segments.back().granule - _page_granule) >= _policy.max_granules;
     }
+
+    return false;
+}
+
+void ogg_stream::_recount() {
+    _page_packets = 0;
+    _page_granule = -1;
+
+    // Only packets finished by what's left count towards the next page
+    for (const segment& seg : _segments) {
+        if (seg.value < 255 && _page_packets++ == 0) {
+            _page_granule = seg.granule;
+        }
+    }
+}
+
+void ogg_stream::_own() {
+    // Most packets are written before pageout returns, only the tail of the last page is copied
+    for (size_t i = _segments.size() - _borrowed; i < _segments.size(); ++i) {
+        segment& seg = _segments[i];
+
+        seg.offset = _buf.size();
+        _buf.insert(_buf.end(), seg.borrowed, seg.borrowed + seg.value);
+        seg.borrowed = nullptr;
+    }
+
+    _borrowed = 0;
+}
+
+const unsigned char* ogg_stream::_data(const segment& seg) const {
+    return seg.borrowed ? seg.borrowed : _buf.data() + seg.offset;
+}
+
+bool ogg_stream::_page(bool force, int fill) {
+    size_t max_segments = std::min<size_t>(_segments.size(), 255);
+    if (max_segments == 0) {
+        return false;
+    }
+
+    size_t segments = 0;
+    int64_t granule = -1;
+
+    if (_first_page) {
+        // The first page only holds the first header packet
+        granule = 0;
+
+        while (segments < max_segments) {
+            if (_segments[segments++].value < 255) {
+                break;
+            }
+        }
+    } else {
+        // Avoid spanning pages needlessly, and don't end a page with less than 4 packets unless forced
+        long acc = 0;
+        int packets_done = 0;
+        int packet_just_done = 0;
+
+        for (; segments < max_segments; ++segments) {
+            if (acc > fill && packet_just_done >= 4) {
+                force = true;
+                break;
+            }
+
+            const auto& seg = _segments[segments];
+
+            acc += seg.value;
+            if (seg.value < 255) {
+                granule = seg.granule;
+                packet_just_done = ++packets_done;
+            } else {
+                packet_just_done = 0;
+            }
+        }
+
+        if (segments == 255) {
+            force = true;
+        }
+    }
+
+    if (!force) {
+        return false;
+    }
+
+    const size_t header_size = 27 + segments;
+    std::array<unsigned char, max_header_size> header;
+
+    std::copy_n("OggS", 4, header.data());
+    header[4] = 0;
+
+    header[5] = 0;
+    if (!_segments.front().begin) {
+        header[5] |= 0x01;
+    }
+
+    if (_first_page) {
+        header[5] |= 0x02;
+    }
+
+    if (_e_o_s && segments == _segments.size()) {
+        header[5] |= 0x04;
+    }
+
+    _first_page = false;
+
+    detail::write_le(header.data() + 6, static_cast<uint64_t>(granule), 8);
+    detail::write_le(header.data() + 14, _serialno, 4);
+    detail::write_le(header.data() + 18, static_cast<uint64_t>(_pageno++), 4);
+    detail::write_le(header.data() + 22, 0, 4);
+
+    header[26] = static_cast<unsigned char>(segments);
+    for (size_t i = 0; i < segments; ++i) {
+        header[27 + i] = _segments[i].value;
+    }
+
+    // The body is gathered from wherever each packet lives, in runs of contiguous segments
+    auto for_each_run = [&](auto&& func) {
+        const unsigned char* run = nullptr;
+        size_t run_size = 0;
+
+        for (size_t i = 0; i < segments; ++i) {
+            const unsigned char* data = _data(_segments[i]);
+
+            if (run && data == run + run_size) {
+                run_size += _segments[i].value;
+            } else {
+                if (run_size > 0) {
+                    func(run, run_size);
+                }
+
+                run = data;
+                run_size = _segments[i].value;
+            }
+        }
+
+        if (run_size > 0) {
+            func(run, run_size);
+        }
+    };
+
+    uint32_t sum = crc(0, header.data(), header_size);
+    for_each_run([&](const unsigned char* data, size_t size) { sum = crc(sum, data, size); });
+
+    detail::write_le(header.data() + 22, sum, 4);
+
+    _out->write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header_size));
+    for_each_run([&](const unsigned char* data, size_t size) {
+        _out->write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+    });
+
+    // Copied data is consumed in order, so whatever was written of it is at the front
+    for (size_t i = 0; i < segments; ++i) {
+        if (!_segments[i].borrowed) {
+            _buf_begin += _segments[i].value;
+        }
+    }
+
+    _segments.erase(_segments.begin(), _segments.begin() + segments);
+    _borrowed = std::min(_borrowed, _segments.size());
+
+    _recount();
+
+    // Reclaim the space used by pages already written
+    if (_buf_begin > 0 && (_buf_begin == _buf.size() || _buf_begin > (_buf.size() / 2))) {
+        _buf.erase(_buf.begin(), _buf.begin() + static_cast<ptrdiff_t>(_buf_begin));
+
+        for (segment& seg : _segments) {
+            if (!seg.borrowed) {
+                seg.offset -= _buf_begin;
+            }
+        }
+
+        _buf_begin = 0;
+    }
+
+    return true;
 }
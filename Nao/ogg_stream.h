@@ -4,24 +4,100 @@
 
 #include <ogg/ogg.h>
 
+// When to end a page, a limit of 0 means no limit
+struct ogg_page_policy {
+    // Page body size to aim for, 0 uses libogg's default of 4096 bytes
+    int fill_bytes = 0;
+
+    // Maximum number of packets finished on a single page
+    int max_packets = 0;
+
+    // Maximum granule distance between the first and last packet finished on a single page, smaller pages make seeking finer
+    int64_t max_granules = 0;
+};
+
+// Ogg page writer, produces the same pages as libogg's ogg_stream_pageout/ogg_stream_flush
 class ogg_stream {
-    ogg_stream_state _os;
+    // 27 fixed bytes and up to 255 lacing values
+    static constexpr size_t max_header_size = 27 + 255;
+    static constexpr int default_fill = 4096;
+
+    struct segment {
+        uint8_t value;
+
+        // First segment of a packet
+        bool begin;
+        int64_t granule;
+
+        // Still in the caller's packet memory, or at offset in _buf once copied
+        const unsigned char* borrowed;
+        size_t offset;
+    };
+
     ostream_ptr _out;
+    uint32_t _serialno;
     int64_t _current_packtet { };
 
     bool _b_o_s = true;
 
+    // Paging state
+    int64_t _pageno = 0;
+    int64_t _granulepos = 0;
+    bool _first_page = true;
+    bool _e_o_s = false;
+
+    // Packet data that outlived the call it was passed in, from _buf_begin on
+    std::vector<unsigned char> _buf;
+    size_t _buf_begin = 0;
+
+    std::vector<segment> _segments;
+
+    // Trailing segments that still point into the caller's packet memory
+    size_t _borrowed = 0;
+
+    ogg_page_policy _policy;
+
+    // Packets finished in the segments not written yet, and the first one's granule
+    int _page_packets = 0;
+    int64_t _page_granule = -1;
+
     public:
-    explicit ogg_stream(const ostream_ptr& out, int serialno = 0);
+    explicit ogg_stream(const ostream_ptr& out, int serialno = 0, const ogg_page_policy& policy = { });
     ~ogg_stream();
 
     ogg_packet packet(char* data, int64_t size, bool eos = false);
 
+    // The packet data isn't copied yet, it has to stay valid until the next pageout or flush
     void packetin(const ogg_packet& packet);
 
-    // Write any full pages that are pending
+    // Write any pages that are full according to the policy, and keep a copy of what's left
     void pageout();
 
     // Write all remaining pages
     void flush();
+
+    const ogg_page_policy& policy() const;
+
+    int64_t packetno() const;
+    int64_t pageno() const;
+
+    // Resume an already started stream at a page boundary, requires all pages to be flushed
+    void restore(int64_t packetno, int64_t pageno);
+
+    // Ogg's CRC32 (polynomial 0x04c11db7, no reflection, no final xor)
+    static uint32_t crc(uint32_t crc, const unsigned char* data, size_t size);
+
+    private:
+    bool _limit_reached() const;
+
+    // Count the packets left for the next page, after one is written
+    void _recount();
+
+    // Copy the packet data still borrowed from the caller
+    void _own();
+
+    const unsigned char* _data(const segment& seg) const;
+
+    // Write a single page if the fill target is reached or it is forced, like libogg's ogg_stream_flush_i
+    bool _page(bool force, int fill);
 };
@@ -0,0 +1,269 @@
+#include "pcm_convert.h"
+
+#include "pcm_interleave.h"
+
+#include <emmintrin.h>
+
+#include <cmath>
+#include <type_traits>
+
+namespace samples {
+    namespace {
+        // Value of full scale for each type, uint8 is centered on 128
+        template <typename T>
+        constexpr double full_scale = static_cast<double>(1ui64 << std::numeric_limits<T>::digits);
+
+        template <>
+        constexpr double full_scale<uint8_t> = 128.;
+
+        template <typename T>
+        constexpr int64_t offset = std::is_same_v<T, uint8_t> ? 128 : 0;
+
+        // Bits to shift left to reach 64-bit signed samples
+        template <typename T>
+        constexpr int shift = 64 - (8 * sizeof(T));
+
+        template <typename In, typename Out>
+        Out convert_sample(In val) {
+            if constexpr (std::is_same_v<In, Out>) {
+                return val;
+            } else if constexpr (std::is_integral_v<In> && std::is_integral_v<Out>) {
+                // Through 64-bit signed, which only shifts for anything but uint8
+                const auto wide = static_cast<int64_t>(static_cast<uint64_t>(static_cast<int64_t>(val) - offset<In>) << shift<In>);
+                return static_cast<Out>((wide >> shift<Out>) + offset<Out>);
+            } else if constexpr (std::is_integral_v<In>) {
+                return static_cast<Out>(static_cast<int64_t>(val) - offset<In>) * static_cast<Out>(1. / full_scale<In>);
+            } else if constexpr (std::is_integral_v<Out>) {
+                constexpr double scale = full_scale<Out>;
+                constexpr int64_t min = std::numeric_limits<Out>::min() - offset<Out>;
+                constexpr int64_t max = std::numeric_limits<Out>::max() - offset<Out>;
+
+                // Saturate, also for values not representable as int64_t
+                const double scaled = static_cast<double>(val) * scale;
+                if (!(scaled < scale)) {
+                    return static_cast<Out>(max + offset<Out>);
+                }
+
+                if (scaled < -scale) {
+                    return static_cast<Out>(min + offset<Out>);
+                }
+
+                return static_cast<Out>(std::clamp<int64_t>(std::llrint(scaled), min, max) + offset<Out>);
+            } else {
+                return static_cast<Out>(val);
+            }
+        }
+
+        // Any pair, one sample at a time
+        template <typename In, typename Out>
+        struct kernel {
+            static void run(const In* in, Out* out, size_t count) {
+                for (size_t i = 0; i < count; ++i) {
+                    out[i] = convert_sample<In, Out>(in[i]);
+                }
+            }
+        };
+
+        template <typename T>
+        struct kernel<T, T> {
+            static void run(const T* in, T* out, size_t count) {
+                std::copy_n(in, count, out);
+            }
+        };
+
+        // Common pairs, with SSE2 bodies and the scalar conversion for the tail
+
+        template <>
+        struct kernel<int16_t, float> {
+            static void run(const int16_t* in, float* out, size_t count) {
+                const __m128 scale = _mm_set1_ps(1.f / 32768.f);
+
+                size_t i = 0;
+                for (; i + 8 <= count; i += 8) {
+                    __m128i val = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+
+                    // Sign extend to 32 bits
+                    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(val, val), 16);
+                    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(val, val), 16);
+
+                    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+                    _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+                }
+
+                for (; i < count; ++i) {
+                    out[i] = convert_sample<int16_t, float>(in[i]);
+                }
+            }
+        };
+
+        template <>
+        struct kernel<float, int16_t> {
+            static void run(const float* in, int16_t* out, size_t count) {
+                const __m128 scale = _mm_set1_ps(32768.f);
+                const __m128 min = _mm_set1_ps(-32768.f);
+                const __m128 max = _mm_set1_ps(32767.f);
+
+                size_t i = 0;
+                for (; i + 8 <= count; i += 8) {
+                    // Clamped first, so the conversion can't overflow, then the pack saturates
+                    __m128 lo = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), min), max);
+                    __m128 hi = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale), min), max);
+
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+                }
+
+                for (; i < count; ++i) {
+                    out[i] = convert_sample<float, int16_t>(in[i]);
+                }
+            }
+        };
+
+        template <>
+        struct kernel<int32_t, float> {
+            static void run(const int32_t* in, float* out, size_t count) {
+                const __m128 scale = _mm_set1_ps(1.f / 2147483648.f);
+
+                size_t i = 0;
+                for (; i + 4 <= count; i += 4) {
+                    __m128i val = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(val), scale));
+                }
+
+                for (; i < count; ++i) {
+                    out[i] = convert_sample<int32_t, float>(in[i]);
+                }
+            }
+        };
+
+        template <>
+        struct kernel<float, int32_t> {
+            static void run(const float* in, int32_t* out, size_t count) {
+                const __m128 scale = _mm_set1_ps(2147483648.f);
+                const __m128 min = _mm_set1_ps(-2147483648.f);
+                const __m128i max = _mm_set1_epi32(std::numeric_limits<int32_t>::max());
+
+                size_t i = 0;
+                for (; i + 4 <= count; i += 4) {
+                    __m128 val = _mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), min);
+
+                    // Full scale and above doesn't fit, those become the maximum
+                    __m128i over = _mm_castps_si128(_mm_cmpge_ps(val, scale));
+                    __m128i res = _mm_cvtps_epi32(val);
+
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                        _mm_or_si128(_mm_andnot_si128(over, res), _mm_and_si128(over, max)));
+                }
+
+                for (; i < count; ++i) {
+                    out[i] = convert_sample<float, int32_t>(in[i]);
+                }
+            }
+        };
+
+        template <>
+        struct kernel<float, double> {
+            static void run(const float* in, double* out, size_t count) {
+                size_t i = 0;
+                for (; i + 4 <= count; i += 4) {
+                    __m128 val = _mm_loadu_ps(in + i);
+
+                    _mm_storeu_pd(out + i, _mm_cvtps_pd(val));
+                    _mm_storeu_pd(out + i + 2, _mm_cvtps_pd(_mm_movehl_ps(val, val)));
+                }
+
+                for (; i < count; ++i) {
+                    out[i] = in[i];
+                }
+            }
+        };
+
+        template <>
+        struct kernel<double, float> {
+            static void run(const double* in, float* out, size_t count) {
+                size_t i = 0;
+                for (; i + 4 <= count; i += 4) {
+                    __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(in + i));
+                    __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(in + i + 2));
+
+                    _mm_storeu_ps(out + i, _mm_movelh_ps(lo, hi));
+                }
+
+                for (; i < count; ++i) {
+                    out[i] = static_cast<float>(in[i]);
+                }
+            }
+        };
+
+        // Call func with a std::type_identity of the type stored by the format
+        template <typename Func>
+        void visit(sample_format fmt, Func&& func) {
+            switch (fmt & sample_format::type_mask) {
+                case sample_format::uint8:   return func(std::type_identity<sample_uint8_t> { });
+                case sample_format::int16:   return func(std::type_identity<sample_int16_t> { });
+                case sample_format::int32:   return func(std::type_identity<sample_int32_t> { });
+                case sample_format::int64:   return func(std::type_identity<sample_int64_t> { });
+                case sample_format::float32: return func(std::type_identity<sample_float32_t> { });
+                case sample_format::float64: return func(std::type_identity<sample_float64_t> { });
+                default: throw std::invalid_argument("invalid sample format");
+            }
+        }
+
+        // Converts between different layouts, one sample at a time
+        template <typename In, typename Out>
+        void convert_strided(const char* const* in, bool in_planar, char* const* out, bool out_planar, size_t channels, size_t frames) {
+            for (size_t c = 0; c < channels; ++c) {
+                const In* src = reinterpret_cast<const In*>(in[in_planar ? c : 0]) + (in_planar ? 0 : c);
+                Out* dest = reinterpret_cast<Out*>(out[out_planar ? c : 0]) + (out_planar ? 0 : c);
+
+                const size_t src_step = in_planar ? 1 : channels;
+                const size_t dest_step = out_planar ? 1 : channels;
+
+                for (size_t i = 0; i < frames; ++i) {
+                    dest[i * dest_step] = convert_sample<In, Out>(src[i * src_step]);
+                }
+            }
+        }
+    }
+
+    void convert(const char* in, sample_format in_fmt, char* out, sample_format out_fmt, size_t count) {
+        visit(in_fmt, [&]<typename In>(std::type_identity<In>) {
+            visit(out_fmt, [&]<typename Out>(std::type_identity<Out>) {
+                kernel<In, Out>::run(reinterpret_cast<const In*>(in), reinterpret_cast<Out*>(out), count);
+            });
+        });
+    }
+
+    void convert(const char* const* in, sample_format in_fmt, char* const* out, sample_format out_fmt, size_t channels, size_t frames) {
+        const bool in_planar = is_planar(in_fmt);
+        const bool out_planar = is_planar(out_fmt);
+
+        if (in_planar == out_planar) {
+            if (in_planar) {
+                for (size_t c = 0; c < channels; ++c) {
+                    convert(in[c], in_fmt, out[c], out_fmt, frames);
+                }
+            } else {
+                convert(in[0], in_fmt, out[0], out_fmt, frames * channels);
+            }
+
+            return;
+        }
+
+        if ((in_fmt & sample_format::type_mask) == (out_fmt & sample_format::type_mask)) {
+            // Only the layout changes
+            if (in_planar) {
+                interleave(in, in_fmt, channels, frames, out[0]);
+            } else {
+                deinterleave(in[0], in_fmt, channels, frames, out);
+            }
+
+            return;
+        }
+
+        visit(in_fmt, [&]<typename In>(std::type_identity<In>) {
+            visit(out_fmt, [&]<typename Out>(std::type_identity<Out>) {
+                convert_strided<In, Out>(in, in_planar, out, out_planar, channels, frames);
+            });
+        });
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "pcm_provider.h"
+
+namespace samples {
+    // Convert count samples between any two sample types, the layout is ignored
+    void convert(const char* in, sample_format in_fmt, char* out, sample_format out_fmt, size_t count);
+
+    // Convert frames frames between any two formats, planar data has a pointer per channel and interleaved data just one
+    void convert(const char* const* in, sample_format in_fmt, char* const* out, sample_format out_fmt, size_t channels, size_t frames);
+}
@@ -0,0 +1,322 @@
+#include "pcm_interleave.h"
+
+#include <emmintrin.h>
+
+#include <array>
+
+namespace samples {
+    namespace {
+        // Only the width matters, so samples are moved as unsigned integers
+        template <typename T>
+        constexpr size_t per_vector = sizeof(__m128i) / sizeof(T);
+
+        template <typename T>
+        __m128i unpack_lo(__m128i a, __m128i b) {
+            if constexpr (sizeof(T) == 1) {
+                return _mm_unpacklo_epi8(a, b);
+            } else if constexpr (sizeof(T) == 2) {
+                return _mm_unpacklo_epi16(a, b);
+            } else if constexpr (sizeof(T) == 4) {
+                return _mm_unpacklo_epi32(a, b);
+            } else {
+                return _mm_unpacklo_epi64(a, b);
+            }
+        }
+
+        template <typename T>
+        __m128i unpack_hi(__m128i a, __m128i b) {
+            if constexpr (sizeof(T) == 1) {
+                return _mm_unpackhi_epi8(a, b);
+            } else if constexpr (sizeof(T) == 2) {
+                return _mm_unpackhi_epi16(a, b);
+            } else if constexpr (sizeof(T) == 4) {
+                return _mm_unpackhi_epi32(a, b);
+            } else {
+                return _mm_unpackhi_epi64(a, b);
+            }
+        }
+
+        __m128i load(const void* src) {
+            return _mm_loadu_si128(static_cast<const __m128i*>(src));
+        }
+
+        void store(void* dest, __m128i val) {
+            _mm_storeu_si128(static_cast<__m128i*>(dest), val);
+        }
+
+        // Transpose 8 rows of 8 16-bit values, in place
+        void transpose_8x16(std::array<__m128i, 8>& r) {
+            __m128i t0 = _mm_unpacklo_epi16(r[0], r[1]);
+            __m128i t1 = _mm_unpackhi_epi16(r[0], r[1]);
+            __m128i t2 = _mm_unpacklo_epi16(r[2], r[3]);
+            __m128i t3 = _mm_unpackhi_epi16(r[2], r[3]);
+            __m128i t4 = _mm_unpacklo_epi16(r[4], r[5]);
+            __m128i t5 = _mm_unpackhi_epi16(r[4], r[5]);
+            __m128i t6 = _mm_unpacklo_epi16(r[6], r[7]);
+            __m128i t7 = _mm_unpackhi_epi16(r[6], r[7]);
+
+            __m128i u0 = _mm_unpacklo_epi32(t0, t2);
+            __m128i u1 = _mm_unpackhi_epi32(t0, t2);
+            __m128i u2 = _mm_unpacklo_epi32(t1, t3);
+            __m128i u3 = _mm_unpackhi_epi32(t1, t3);
+            __m128i u4 = _mm_unpacklo_epi32(t4, t6);
+            __m128i u5 = _mm_unpackhi_epi32(t4, t6);
+            __m128i u6 = _mm_unpacklo_epi32(t5, t7);
+            __m128i u7 = _mm_unpackhi_epi32(t5, t7);
+
+            r[0] = _mm_unpacklo_epi64(u0, u4);
+            r[1] = _mm_unpackhi_epi64(u0, u4);
+            r[2] = _mm_unpacklo_epi64(u1, u5);
+            r[3] = _mm_unpackhi_epi64(u1, u5);
+            r[4] = _mm_unpacklo_epi64(u2, u6);
+            r[5] = _mm_unpackhi_epi64(u2, u6);
+            r[6] = _mm_unpacklo_epi64(u3, u7);
+            r[7] = _mm_unpackhi_epi64(u3, u7);
+        }
+
+        // Transpose 4 rows of 4 32-bit values, in place
+        void transpose_4x32(__m128i* r) {
+            __m128i t0 = _mm_unpacklo_epi32(r[0], r[1]);
+            __m128i t1 = _mm_unpackhi_epi32(r[0], r[1]);
+            __m128i t2 = _mm_unpacklo_epi32(r[2], r[3]);
+            __m128i t3 = _mm_unpackhi_epi32(r[2], r[3]);
+
+            r[0] = _mm_unpacklo_epi64(t0, t2);
+            r[1] = _mm_unpackhi_epi64(t0, t2);
+            r[2] = _mm_unpacklo_epi64(t1, t3);
+            r[3] = _mm_unpackhi_epi64(t1, t3);
+        }
+
+        // Scalar paths, with a compile-time channel count where possible so the inner loop unrolls
+
+        template <typename T, size_t Channels>
+        void interleave_fixed(const char* const* planes, size_t first, size_t frames, char* out) {
+            std::array<const T*, Channels> in;
+            for (size_t c = 0; c < Channels; ++c) {
+                in[c] = reinterpret_cast<const T*>(planes[c]);
+            }
+
+            T* dest = reinterpret_cast<T*>(out) + (first * Channels);
+            for (size_t i = first; i < frames; ++i) {
+                for (size_t c = 0; c < Channels; ++c) {
+                    *dest++ = in[c][i];
+                }
+            }
+        }
+
+        template <typename T>
+        void interleave_any(const char* const* planes, size_t channels, size_t frames, char* out) {
+            T* dest = reinterpret_cast<T*>(out);
+            for (size_t c = 0; c < channels; ++c) {
+                const T* in = reinterpret_cast<const T*>(planes[c]);
+                for (size_t i = 0; i < frames; ++i) {
+                    dest[(i * channels) + c] = in[i];
+                }
+            }
+        }
+
+        template <typename T, size_t Channels>
+        void deinterleave_fixed(const char* in, size_t first, size_t frames, char* const* planes) {
+            std::array<T*, Channels> out;
+            for (size_t c = 0; c < Channels; ++c) {
+                out[c] = reinterpret_cast<T*>(planes[c]);
+            }
+
+            const T* src = reinterpret_cast<const T*>(in) + (first * Channels);
+            for (size_t i = first; i < frames; ++i) {
+                for (size_t c = 0; c < Channels; ++c) {
+                    out[c][i] = *src++;
+                }
+            }
+        }
+
+        template <typename T>
+        void deinterleave_any(const char* in, size_t channels, size_t frames, char* const* planes) {
+            const T* src = reinterpret_cast<const T*>(in);
+            for (size_t c = 0; c < channels; ++c) {
+                T* out = reinterpret_cast<T*>(planes[c]);
+                for (size_t i = 0; i < frames; ++i) {
+                    out[i] = src[(i * channels) + c];
+                }
+            }
+        }
+
+        // Stereo, any width: one unpack pair per vector of each channel
+
+        template <typename T>
+        void interleave_2(const char* const* planes, size_t frames, char* out) {
+            constexpr size_t step = per_vector<T>;
+
+            size_t i = 0;
+            for (; i + step <= frames; i += step) {
+                __m128i l = load(planes[0] + (i * sizeof(T)));
+                __m128i r = load(planes[1] + (i * sizeof(T)));
+
+                char* dest = out + (i * 2 * sizeof(T));
+                store(dest, unpack_lo<T>(l, r));
+                store(dest + sizeof(__m128i), unpack_hi<T>(l, r));
+            }
+
+            interleave_fixed<T, 2>(planes, i, frames, out);
+        }
+
+        template <typename T>
+        void deinterleave_2(const char* in, size_t frames, char* const* planes) {
+            constexpr size_t step = per_vector<T>;
+
+            size_t i = 0;
+            for (; i + step <= frames; i += step) {
+                const char* src = in + (i * 2 * sizeof(T));
+                __m128i a = load(src);
+                __m128i b = load(src + sizeof(__m128i));
+
+                __m128i l, r;
+                if constexpr (sizeof(T) == 1) {
+                    const __m128i mask = _mm_set1_epi16(0x00FF);
+                    l = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+                    r = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+                } else if constexpr (sizeof(T) == 2) {
+                    // Sign extended, so the saturating pack leaves the values alone
+                    l = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+                    r = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+                } else if constexpr (sizeof(T) == 4) {
+                    __m128 fa = _mm_castsi128_ps(a);
+                    __m128 fb = _mm_castsi128_ps(b);
+                    l = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+                    r = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+                } else {
+                    l = _mm_unpacklo_epi64(a, b);
+                    r = _mm_unpackhi_epi64(a, b);
+                }
+
+                store(planes[0] + (i * sizeof(T)), l);
+                store(planes[1] + (i * sizeof(T)), r);
+            }
+
+            deinterleave_fixed<T, 2>(in, i, frames, planes);
+        }
+
+        // 7.1, transposing blocks of 8 frames for 16-bit and 4 frames for 32-bit samples
+
+        template <typename T>
+        void interleave_8(const char* const* planes, size_t frames, char* out) {
+            size_t i = 0;
+
+            if constexpr (sizeof(T) == 2) {
+                std::array<__m128i, 8> r;
+                for (; i + 8 <= frames; i += 8) {
+                    for (size_t c = 0; c < 8; ++c) {
+                        r[c] = load(planes[c] + (i * sizeof(T)));
+                    }
+
+                    transpose_8x16(r);
+
+                    char* dest = out + (i * 8 * sizeof(T));
+                    for (size_t f = 0; f < 8; ++f) {
+                        store(dest + (f * sizeof(__m128i)), r[f]);
+                    }
+                }
+            } else if constexpr (sizeof(T) == 4) {
+                std::array<__m128i, 8> r;
+                for (; i + 4 <= frames; i += 4) {
+                    for (size_t c = 0; c < 8; ++c) {
+                        r[c] = load(planes[c] + (i * sizeof(T)));
+                    }
+
+                    // Channels 0-3 and 4-7 form the two halves of each frame
+                    transpose_4x32(r.data());
+                    transpose_4x32(r.data() + 4);
+
+                    char* dest = out + (i * 8 * sizeof(T));
+                    for (size_t f = 0; f < 4; ++f) {
+                        store(dest + (f * 2 * sizeof(__m128i)), r[f]);
+                        store(dest + (f * 2 * sizeof(__m128i)) + sizeof(__m128i), r[f + 4]);
+                    }
+                }
+            }
+
+            interleave_fixed<T, 8>(planes, i, frames, out);
+        }
+
+        template <typename T>
+        void deinterleave_8(const char* in, size_t frames, char* const* planes) {
+            size_t i = 0;
+
+            if constexpr (sizeof(T) == 2) {
+                std::array<__m128i, 8> r;
+                for (; i + 8 <= frames; i += 8) {
+                    const char* src = in + (i * 8 * sizeof(T));
+                    for (size_t f = 0; f < 8; ++f) {
+                        r[f] = load(src + (f * sizeof(__m128i)));
+                    }
+
+                    transpose_8x16(r);
+
+                    for (size_t c = 0; c < 8; ++c) {
+                        store(planes[c] + (i * sizeof(T)), r[c]);
+                    }
+                }
+            } else if constexpr (sizeof(T) == 4) {
+                std::array<__m128i, 8> r;
+                for (; i + 4 <= frames; i += 4) {
+                    const char* src = in + (i * 8 * sizeof(T));
+                    for (size_t f = 0; f < 4; ++f) {
+                        r[f] = load(src + (f * 2 * sizeof(__m128i)));
+                        r[f + 4] = load(src + (f * 2 * sizeof(__m128i)) + sizeof(__m128i));
+                    }
+
+                    transpose_4x32(r.data());
+                    transpose_4x32(r.data() + 4);
+
+                    for (size_t c = 0; c < 8; ++c) {
+                        store(planes[c] + (i * sizeof(T)), r[c]);
+                    }
+                }
+            }
+
+            deinterleave_fixed<T, 8>(in, i, frames, planes);
+        }
+
+        template <typename T>
+        void interleave_width(const char* const* planes, size_t channels, size_t frames, char* out) {
+            switch (channels) {
+                case 1: std::copy_n(planes[0], frames * sizeof(T), out); break;
+                case 2: interleave_2<T>(planes, frames, out); break;
+                case 6: interleave_fixed<T, 6>(planes, 0, frames, out); break;
+                case 8: interleave_8<T>(planes, frames, out); break;
+                default: interleave_any<T>(planes, channels, frames, out); break;
+            }
+        }
+
+        template <typename T>
+        void deinterleave_width(const char* in, size_t channels, size_t frames, char* const* planes) {
+            switch (channels) {
+                case 1: std::copy_n(in, frames * sizeof(T), planes[0]); break;
+                case 2: deinterleave_2<T>(in, frames, planes); break;
+                case 6: deinterleave_fixed<T, 6>(in, 0, frames, planes); break;
+                case 8: deinterleave_8<T>(in, frames, planes); break;
+                default: deinterleave_any<T>(in, channels, frames, planes); break;
+            }
+        }
+    }
+
+    void interleave(const char* const* planes, sample_format fmt, size_t channels, size_t frames, char* out) {
+        switch (sample_size(fmt)) {
+            case 1: interleave_width<uint8_t>(planes, channels, frames, out); break;
+            case 2: interleave_width<uint16_t>(planes, channels, frames, out); break;
+            case 4: interleave_width<uint32_t>(planes, channels, frames, out); break;
+            case 8: interleave_width<uint64_t>(planes, channels, frames, out); break;
+            default: throw std::invalid_argument("invalid sample format");
+        }
+    }
+
+    void deinterleave(const char* in, sample_format fmt, size_t channels, size_t frames, char* const* planes) {
+        switch (sample_size(fmt)) {
+            case 1: deinterleave_width<uint8_t>(in, channels, frames, planes); break;
+            case 2: deinterleave_width<uint16_t>(in, channels, frames, planes); break;
+            case 4: deinterleave_width<uint32_t>(in, channels, frames, planes); break;
+            case 8: deinterleave_width<uint64_t>(in, channels, frames, planes); break;
+            default: throw std::invalid_argument("invalid sample format");
+        }
+    }
+}
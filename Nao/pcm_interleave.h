@@ -0,0 +1,11 @@
+#pragma once
+
+#include "pcm_provider.h"
+
+namespace samples {
+    // Interleave the first frames samples of every plane into out
+    void interleave(const char* const* planes, sample_format fmt, size_t channels, size_t frames, char* out);
+
+    // Split frames interleaved frames into one plane per channel
+    void deinterleave(const char* in, sample_format fmt, size_t channels, size_t frames, char* const* planes);
+}
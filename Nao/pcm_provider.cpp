@@ -1,6 +1,10 @@
 #include "pcm_provider.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <bit>
+#include <utility>
+
 namespace samples {
     size_t sample_size(sample_format fmt) {
         switch (fmt & sample_format::type_mask) {
@@ -73,13 +77,96 @@ namespace samples {
         }
     }
 
+    uint64_t channel_layout(uint64_t mask, size_t channels) {
+        if (std::popcount(mask) == static_cast<int>(channels)) {
+            return mask;
+        }
+
+        return av_get_default_channel_layout(static_cast<int>(channels));
+    }
+
+}
+
+pcm_buffer pcm_buffer_pool::acquire(size_t bytes) {
+    std::scoped_lock lock { _mutex };
+
+    // Smallest one that fits
+    auto best = _free.end();
+    for (auto it = _free.begin(); it != _free.end(); ++it) {
+        if (it->capacity >= bytes && (best == _free.end() || it->capacity < best->capacity)) {
+            best = it;
+        }
+    }
+
+    if (best != _free.end()) {
+        pcm_buffer buf = std::move(*best);
+        *best = std::move(_free.back());
+        _free.pop_back();
+
+        return buf;
+    }
+
+    return { std::make_unique_for_overwrite<char[]>(bytes), bytes };
+}
+
+void pcm_buffer_pool::release(pcm_buffer buf) {
+    if (!buf.data) {
+        return;
+    }
+
+    std::scoped_lock lock { _mutex };
 
+    if (_free.size() < max_free) {
+        _free.push_back(std::move(buf));
+    } else {
+        // Full, replace the smallest one if this one is larger
+        auto smallest = std::min_element(_free.begin(), _free.end(),
+            [](const pcm_buffer& a, const pcm_buffer& b) { return a.capacity < b.capacity; });
+
+        if (smallest->capacity < buf.capacity) {
+            *smallest = std::move(buf);
+        }
+    }
 }
 
 pcm_samples::pcm_samples(sample_format type, uint64_t frames, uint8_t channels, uint64_t channel_layout)
     : _type { type }, _frames { frames }, _channels { channels }, _channel_layout { channel_layout }
-    , _data(_frames * _channels * samples::sample_size(type), 0) {
-    
+    , _bytes { _frames * _channels * samples::sample_size(type) } {
+    _data = { std::make_unique<char[]>(_bytes), _bytes };
+}
+
+pcm_samples::pcm_samples(const pcm_buffer_pool_ptr& pool, sample_format type, uint64_t frames, uint8_t channels, uint64_t channel_layout)
+    : _type { type }, _frames { frames }, _channels { channels }, _channel_layout { channel_layout }
+    , _bytes { _frames * _channels * samples::sample_size(type) }, _pool { pool } {
+    if (_bytes > 0) {
+        _data = _pool->acquire(_bytes);
+    }
+}
+
+pcm_samples::pcm_samples(pcm_samples&& other) noexcept
+    : _type { other._type }, _frames { other._frames }, _channels { other._channels }, _channel_layout { other._channel_layout }
+    , _data { std::move(other._data) }, _bytes { std::exchange(other._bytes, 0) }, _pool { std::move(other._pool) } {
+    other._frames = 0;
+}
+
+pcm_samples& pcm_samples::operator=(pcm_samples&& other) noexcept {
+    if (this != &other) {
+        _release();
+
+        _type = other._type;
+        _frames = std::exchange(other._frames, 0);
+        _channels = other._channels;
+        _channel_layout = other._channel_layout;
+        _data = std::move(other._data);
+        _bytes = std::exchange(other._bytes, 0);
+        _pool = std::move(other._pool);
+    }
+
+    return *this;
+}
+
+pcm_samples::~pcm_samples() {
+    _release();
 }
 
 int64_t pcm_samples::frames() const {
@@ -95,21 +182,36 @@ int64_t pcm_samples::samples() const {
 }
 
 size_t pcm_samples::bytes() const {
-    return _data.size();
+    return _bytes;
 }
 
 char* pcm_samples::data() {
-    return _data.data();
+    return _data.data.get();
 }
 
 const char* pcm_samples::data() const {
-    return _data.data();
+    return _data.data.get();
 }
 
 pcm_samples::operator bool() const {
-    return _frames > 0 && _channels > 0 && !_data.empty() && _type != sample_format::none;
+    return _frames > 0 && _channels > 0 && _bytes > 0 && _type != sample_format::none;
+}
+
+void pcm_samples::_release() {
+    if (_pool) {
+        _pool->release(std::move(_data));
+        _pool.reset();
+    }
+
+    _data = { };
+    _bytes = 0;
 }
 
-pcm_provider::pcm_provider(istream_ptr stream) : stream { std::move(stream) } {
+pcm_provider::pcm_provider(istream_ptr stream)
+    : stream { std::move(stream) }, buffers { std::make_shared<pcm_buffer_pool>() } {
     
 }
+
+uint64_t pcm_provider::channel_layout() {
+    return samples::channel_layout(0, channels());
+}
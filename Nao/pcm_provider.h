@@ -3,9 +3,11 @@
 #include "binary_stream.h"
 
 #include <bitset>
+#include <mutex>
 
 extern "C" {
 #include <libavutil/samplefmt.h>
+#include <libavutil/channel_layout.h>
 }
 
 enum class sample_format : uint64_t {
@@ -41,6 +43,8 @@ namespace samples {
 
     std::string format_name(sample_format fmt);
 
+    // The mask if it has a speaker for every channel, FFmpeg's default layout for the channel count otherwise
+    uint64_t channel_layout(uint64_t mask, size_t channels);
 }
 
 inline sample_format operator|(sample_format left, sample_format right) {
@@ -100,20 +104,59 @@ enum pcm_state : int64_t {
     PCM_ERR = -1
 };
 
+// Sample storage, only the first capacity bytes are usable
+struct pcm_buffer {
+    std::unique_ptr<char[]> data;
+    size_t capacity = 0;
+};
+
+// Recycles sample storage between pcm_samples instances
+class pcm_buffer_pool {
+    // Keep at most this many unused buffers around
+    static constexpr size_t max_free = 8;
+
+    std::mutex _mutex;
+    std::vector<pcm_buffer> _free;
+
+    public:
+    // Buffer of at least the specified size, contents are not initialised
+    pcm_buffer acquire(size_t bytes);
+    void release(pcm_buffer buf);
+};
+
+using pcm_buffer_pool_ptr = std::shared_ptr<pcm_buffer_pool>;
+
 // Encapsulates audio samples
 class pcm_samples final {
     sample_format _type = sample_format::none;
     uint64_t _frames = 0;
-    uint8_t _channels;
+    uint8_t _channels = 0;
 
     // avutil channel layout
     uint64_t _channel_layout = 0;
 
-    std::vector<char> _data { };
+    pcm_buffer _data { };
+    size_t _bytes = 0;
+
+    // Where the storage goes back to, if borrowed
+    pcm_buffer_pool_ptr _pool;
+
     public:
     pcm_samples() = default;
+
+    // Zero-initialised samples
     pcm_samples(sample_format type, uint64_t frames, uint8_t channels, uint64_t channel_layout);
 
+    // Uninitialised samples borrowed from a pool, for when all of them are written right away
+    pcm_samples(const pcm_buffer_pool_ptr& pool, sample_format type, uint64_t frames, uint8_t channels, uint64_t channel_layout);
+
+    pcm_samples(pcm_samples&& other) noexcept;
+    pcm_samples& operator=(pcm_samples&& other) noexcept;
+    ~pcm_samples();
+
+    pcm_samples(const pcm_samples&) = delete;
+    pcm_samples& operator=(const pcm_samples&) = delete;
+
     int64_t frames() const;
     uint8_t channels() const;
     int64_t samples() const;
@@ -126,33 +169,36 @@ class pcm_samples final {
 
     template <sample_format type>
     sample_format_t<type>* data() {
-        return reinterpret_cast<sample_format_t<type>*>(_data.data());
+        return reinterpret_cast<sample_format_t<type>*>(_data.data.get());
     }
 
     template <sample_format type>
     const sample_format_t<type>* data() const {
-        return reinterpret_cast<const sample_format_t<type>*>(_data.data());
+        return reinterpret_cast<const sample_format_t<type>*>(_data.data.get());
     }
 
     template <concepts::iterator<char> InputIt>
     size_t fill(InputIt begin, InputIt end) {
-        if (std::distance(begin, end) > _data.size()) {
+        if (std::distance(begin, end) > _bytes) {
             throw std::out_of_range("tried to fill past end");
         }
 
-        return std::distance(_data.begin(),
-            std::copy(begin, end, _data.begin()));
+        return std::distance(_data.data.get(),
+            std::copy(begin, end, _data.data.get()));
     }
 
     template <concepts::iterator<char> InputIt>
     size_t fill_n(InputIt begin, size_t count) {
-        if (count > _data.size()) {
+        if (count > _bytes) {
             throw std::out_of_range("tried to fill past end");
         }
 
-        return std::distance(_data.begin(),
-            std::copy_n(begin, count, _data.begin()));
+        return std::distance(_data.data.get(),
+            std::copy_n(begin, count, _data.data.get()));
     }
+
+    private:
+    void _release();
 };
 
 class pcm_decode_exception : public std::runtime_error {
@@ -164,6 +210,9 @@ class pcm_provider {
     protected:
     istream_ptr stream;
 
+    // Storage for returned samples
+    pcm_buffer_pool_ptr buffers;
+
     public:
     explicit pcm_provider(istream_ptr stream);
     virtual ~pcm_provider() = default;
@@ -171,6 +220,9 @@ class pcm_provider {
     virtual pcm_samples get_samples() = 0;
     virtual int64_t rate() = 0;
     virtual int64_t channels() = 0;
+
+    // Speakers present, as a WAVEFORMATEXTENSIBLE/avutil channel mask
+    virtual uint64_t channel_layout();
     virtual std::string name() = 0;
 
     virtual std::chrono::nanoseconds duration() = 0;
@@ -0,0 +1,92 @@
+#include "pcm_reader.h"
+
+#include "pcm_convert.h"
+
+#include "ffmpeg.h"
+
+#include <array>
+
+pcm_reader::pcm_reader(pcm_provider_ptr provider)
+    : _provider { std::move(provider) }
+    , _in_fmt { samples::from_av(av_get_packed_sample_fmt(samples::to_av(_provider->format()))) }
+    , _channels { utils::narrow<uint8_t>(_provider->channels()) }
+    , _rate { _provider->rate() } {
+    ASSERT(_channels > 0 && _channels <= AV_NUM_DATA_POINTERS);
+}
+
+pcm_provider* pcm_reader::provider() const {
+    return _provider.get();
+}
+
+size_t pcm_reader::bytes_for(sample_format fmt, int64_t frames) const {
+    return frames * _channels * samples::sample_size(fmt);
+}
+
+int64_t pcm_reader::read(std::span<std::byte> out, sample_format fmt, int64_t frames) {
+    if (out.size() < bytes_for(fmt, frames)) {
+        throw std::out_of_range("output buffer too small");
+    }
+
+    const size_t in_frame_size = samples::sample_size(_in_fmt) * _channels;
+
+    int64_t done = 0;
+    while (done < frames) {
+        if (_pending_pos >= _pending.frames()) {
+            if (_eof) {
+                break;
+            }
+
+            _pending = _provider->get_samples();
+            _pending_pos = 0;
+
+            if (!_pending) {
+                _eof = true;
+                break;
+            }
+        }
+
+        // As much of the current block as fits
+        const int64_t count = std::min(frames - done, _pending.frames() - _pending_pos);
+
+        _convert(_pending.data() + (_pending_pos * in_frame_size), count, out.data(), fmt, frames, done);
+
+        _pending_pos += count;
+        done += count;
+    }
+
+    return done;
+}
+
+std::chrono::nanoseconds pcm_reader::pos() const {
+    // The provider is ahead by whatever is left of the current block
+    const int64_t left = _pending.frames() - _pending_pos;
+    return _provider->pos() - std::chrono::nanoseconds { left * 1'000'000'000 / _rate };
+}
+
+void pcm_reader::seek(std::chrono::nanoseconds pos) {
+    _provider->seek(pos);
+
+    _pending = { };
+    _pending_pos = 0;
+    _eof = false;
+}
+
+bool pcm_reader::eof() const {
+    return _eof && _pending_pos >= _pending.frames();
+}
+
+void pcm_reader::_convert(const char* src, int64_t count, std::byte* out, sample_format fmt, int64_t frames, int64_t offset) {
+    const size_t sample_size = samples::sample_size(fmt);
+    const bool planar = samples::is_planar(fmt);
+
+    std::array<char*, AV_NUM_DATA_POINTERS> planes;
+    if (planar) {
+        for (uint8_t c = 0; c < _channels; ++c) {
+            planes[c] = reinterpret_cast<char*>(out) + (((c * frames) + offset) * sample_size);
+        }
+    } else {
+        planes[0] = reinterpret_cast<char*>(out) + (offset * _channels * sample_size);
+    }
+
+    samples::convert(&src, _in_fmt, planes.data(), fmt, _channels, count);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "pcm_provider.h"
+
+#include <span>
+
+// Pulls a provider's samples into caller buffers, in any format and in blocks of any size
+class pcm_reader {
+    pcm_provider_ptr _provider;
+
+    // Packed version of the provider's format, which is what get_samples returns
+    sample_format _in_fmt;
+    uint8_t _channels;
+    int64_t _rate;
+
+    // Last block returned by the provider, and the frames of it used so far
+    pcm_samples _pending;
+    int64_t _pending_pos = 0;
+    bool _eof = false;
+
+    public:
+    explicit pcm_reader(pcm_provider_ptr provider);
+
+    pcm_provider* provider() const;
+
+    // Size of the buffer needed for frames frames in the specified format
+    size_t bytes_for(sample_format fmt, int64_t frames) const;
+
+    // Fill out with exactly frames frames, fewer only at the end of the stream, and return the number of frames read.
+    // Planar formats are written one channel after the other, every plane frames long.
+    int64_t read(std::span<std::byte> out, sample_format fmt, int64_t frames);
+
+    // Position of the next frame read
+    std::chrono::nanoseconds pos() const;
+    void seek(std::chrono::nanoseconds pos);
+
+    bool eof() const;
+
+    private:
+    // Convert count interleaved frames from src to out, offset frames into every plane
+    void _convert(const char* src, int64_t count, std::byte* out, sample_format fmt, int64_t frames, int64_t offset);
+};
@@ -0,0 +1,272 @@
+#include "resampler.h"
+
+#include <emmintrin.h>
+
+#include <map>
+#include <tuple>
+#include <numeric>
+#include <numbers>
+
+namespace detail {
+    struct profile {
+        size_t taps;
+
+        // Passband edge as a fraction of the lower Nyquist frequency
+        double rolloff;
+
+        // Kaiser window shape
+        double beta;
+    };
+
+    // Banks with up to this many phases stay cached, which covers every pair of the usual rates.
+    // Larger ones, 48000 phases for 47999 to 48000, are only shared while in use.
+    static constexpr int64_t max_kept_phases = 1024;
+
+    static profile profile_for(resampler::quality quality) {
+        switch (quality) {
+            case resampler::quality::fast: return { 16, 0.85, 6. };
+            case resampler::quality::best: return { 64, 0.95, 10. };
+            default:                       return { 32, 0.91, 8. };
+        }
+    }
+
+    // Zeroth order modified Bessel function of the first kind
+    static double bessel_i0(double x) {
+        double sum = 1.;
+        double term = 1.;
+
+        for (int k = 1; k < 50; ++k) {
+            term *= (x / (2. * k)) * (x / (2. * k));
+            sum += term;
+
+            if (term < (sum * 1e-12)) {
+                break;
+            }
+        }
+
+        return sum;
+    }
+
+    // Kaiser windowed sinc, one set of taps for each of the up output phases
+    static void fill_bank(polyphase_resampler::filter_bank& bank, int64_t up, int64_t down, resampler::quality quality) {
+        const profile profile = profile_for(quality);
+
+        bank.up = up;
+        bank.down = down;
+        bank.taps = profile.taps;
+        bank.coefs.resize(up * profile.taps);
+
+        // Cutoff in cycles per input sample, below the lower of the two Nyquist frequencies
+        const double cutoff = 0.5 * profile.rolloff * std::min(1., static_cast<double>(up) / static_cast<double>(down));
+        const double half = static_cast<double>(profile.taps) / 2.;
+        const double window_norm = bessel_i0(profile.beta);
+
+        for (int64_t p = 0; p < up; ++p) {
+            float* phase = bank.coefs.data() + (p * profile.taps);
+
+            for (size_t j = 0; j < profile.taps; ++j) {
+                // Distance from the output to the input sample this tap is applied to
+                const double t = (half - 1. - static_cast<double>(j)) + (static_cast<double>(p) / static_cast<double>(up));
+
+                const double x = 2. * cutoff * t;
+                const double sinc = (x == 0.) ? 1. : std::sin(std::numbers::pi * x) / (std::numbers::pi * x);
+
+                const double w = t / half;
+                const double window = (std::abs(w) >= 1.) ? 0. : bessel_i0(profile.beta * std::sqrt(1. - (w * w))) / window_norm;
+
+                phase[j] = static_cast<float>(2. * cutoff * sinc * window);
+            }
+        }
+    }
+
+    static float dot(const float* a, const float* b, size_t count) {
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+
+        // Taps are a multiple of 4, and usually of 8
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        }
+
+        if (i < count) {
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        }
+
+        __m128 sum = _mm_add_ps(acc0, acc1);
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+
+        return _mm_cvtss_f32(sum);
+    }
+}
+
+std::unique_ptr<resampler> resampler::create(kind kind, size_t channels, int64_t in_rate, int64_t out_rate, quality quality) {
+    switch (kind) {
+        case kind::swresample: return std::make_unique<swr_resampler>(channels, in_rate, out_rate);
+        default:               return std::make_unique<polyphase_resampler>(channels, in_rate, out_rate, quality);
+    }
+}
+
+polyphase_resampler::polyphase_resampler(size_t channels, int64_t in_rate, int64_t out_rate, quality quality)
+    : _channels { channels }, _bank { bank(in_rate, out_rate, quality) }, _buf(channels) {
+    ASSERT(_channels > 0);
+
+    reset();
+}
+
+std::shared_ptr<const polyphase_resampler::filter_bank> polyphase_resampler::bank(int64_t in_rate, int64_t out_rate, quality quality) {
+    ASSERT(in_rate > 0 && out_rate > 0);
+
+    static std::mutex mutex;
+    static std::map<std::tuple<int64_t, int64_t, resampler::quality>, std::weak_ptr<const filter_bank>> banks;
+
+    // Holds on to the small banks after their last resampler is gone
+    static std::vector<std::shared_ptr<const filter_bank>> kept;
+
+    const int64_t div = std::gcd(in_rate, out_rate);
+    const int64_t up = out_rate / div;
+    const int64_t down = in_rate / div;
+
+    std::scoped_lock lock { mutex };
+
+    std::erase_if(banks, [](const auto& entry) { return entry.second.expired(); });
+
+    auto& cached = banks[{ up, down, quality }];
+    if (auto result = cached.lock()) {
+        return result;
+    }
+
+    auto result = std::make_shared<filter_bank>();
+
+    if (up == 1 && down == 1) {
+        // Same rate, a single tap passes the input through untouched
+        result->up = 1;
+        result->down = 1;
+        result->taps = 4;
+        result->coefs = { 0.f, 1.f, 0.f, 0.f };
+    } else {
+        detail::fill_bank(*result, up, down, quality);
+    }
+
+    cached = result;
+    if (up <= detail::max_kept_phases) {
+        kept.push_back(result);
+    }
+
+    return result;
+}
+
+int64_t polyphase_resampler::max_output(int64_t in_frames) const {
+    const int64_t pending = static_cast<int64_t>(_buf[0].size()) + static_cast<int64_t>(_bank->taps) + in_frames;
+    return ((pending * _bank->up) / _bank->down) + 1;
+}
+
+int64_t polyphase_resampler::process(const float* in, int64_t in_frames, float* out, int64_t out_frames) {
+    for (size_t c = 0; c < _channels; ++c) {
+        std::vector<float>& buf = _buf[c];
+        const size_t offset = buf.size();
+
+        buf.resize(offset + in_frames);
+        for (int64_t i = 0; i < in_frames; ++i) {
+            buf[offset + i] = in[(i * _channels) + c];
+        }
+    }
+
+    _consumed += in_frames;
+
+    return _run(out, out_frames, -1);
+}
+
+int64_t polyphase_resampler::flush(float* out, int64_t out_frames) {
+    // Push the last input through the filter with silence
+    for (std::vector<float>& buf : _buf) {
+        buf.resize(buf.size() + _bank->taps, 0.f);
+    }
+
+    const int64_t expected = ((_consumed * _bank->up) + _bank->down - 1) / _bank->down;
+
+    return _run(out, out_frames, expected - _produced);
+}
+
+void polyphase_resampler::reset() {
+    // Starts with half a filter of silence, so the first output lines up with the first input
+    const size_t lead = (_bank->taps / 2) - 1;
+    for (std::vector<float>& buf : _buf) {
+        buf.assign(lead, 0.f);
+    }
+
+    _index = lead;
+    _phase = 0;
+    _consumed = 0;
+    _produced = 0;
+}
+
+int64_t polyphase_resampler::_run(float* out, int64_t out_frames, int64_t limit) {
+    const size_t taps = _bank->taps;
+    const auto available = static_cast<int64_t>(_buf[0].size());
+
+    if (limit >= 0) {
+        out_frames = std::min(out_frames, limit);
+    }
+
+    int64_t written = 0;
+
+    // The taps for an output at _index span from _index - (taps / 2 - 1) to _index + taps / 2
+    while (written < out_frames && (_index + static_cast<int64_t>(taps / 2)) < available) {
+        const float* coefs = _bank->coefs.data() + (_phase * taps);
+        const int64_t first = _index - static_cast<int64_t>(taps / 2) + 1;
+
+        for (size_t c = 0; c < _channels; ++c) {
+            *out++ = detail::dot(_buf[c].data() + first, coefs, taps);
+        }
+
+        ++written;
+
+        _phase += _bank->down;
+        _index += _phase / _bank->up;
+        _phase %= _bank->up;
+    }
+
+    _produced += written;
+
+    // Drop input no later output needs
+    const int64_t drop = std::min(_index - static_cast<int64_t>(taps / 2) + 1, available);
+    if (drop > 0) {
+        for (std::vector<float>& buf : _buf) {
+            buf.erase(buf.begin(), buf.begin() + drop);
+        }
+
+        _index -= drop;
+    }
+
+    return written;
+}
+
+swr_resampler::swr_resampler(size_t channels, int64_t in_rate, int64_t out_rate)
+    : _in { av_get_default_channel_layout(static_cast<int>(channels)), AV_SAMPLE_FMT_FLT, in_rate }
+    , _out { _in.channel_layout, AV_SAMPLE_FMT_FLT, out_rate } {
+    reset();
+}
+
+int64_t swr_resampler::max_output(int64_t in_frames) const {
+    return _swr->frames_for_input(in_frames);
+}
+
+int64_t swr_resampler::process(const float* in, int64_t in_frames, float* out, int64_t out_frames) {
+    char* src = reinterpret_cast<char*>(const_cast<float*>(in));
+    char* dest = reinterpret_cast<char*>(out);
+
+    return _swr->convert(&src, in_frames, &dest, out_frames);
+}
+
+int64_t swr_resampler::flush(float* out, int64_t out_frames) {
+    char* dest = reinterpret_cast<char*>(out);
+
+    return _swr->convert(nullptr, 0, &dest, out_frames);
+}
+
+void swr_resampler::reset() {
+    _swr = std::make_unique<ffmpeg::swresample::context>(_in, _out);
+}
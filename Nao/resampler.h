@@ -0,0 +1,99 @@
+#pragma once
+
+#include "ffmpeg.h"
+
+#include <mutex>
+
+// Converts the sample rate of interleaved float frames
+class resampler {
+    public:
+    enum class kind {
+        polyphase,
+        swresample
+    };
+
+    // Filter length against delay and speed
+    enum class quality {
+        fast,
+        balanced,
+        best
+    };
+
+    virtual ~resampler() = default;
+
+    // Most frames produced by the next process call with in_frames frames, or by flush with 0
+    virtual int64_t max_output(int64_t in_frames) const = 0;
+
+    // Convert in_frames frames, returns the number of frames written to out
+    virtual int64_t process(const float* in, int64_t in_frames, float* out, int64_t out_frames) = 0;
+
+    // Output whatever is still held back at the end of the stream
+    virtual int64_t flush(float* out, int64_t out_frames) = 0;
+
+    // Forget all input, as after a seek
+    virtual void reset() = 0;
+
+    static std::unique_ptr<resampler> create(kind kind, size_t channels, int64_t in_rate, int64_t out_rate, quality quality);
+};
+
+// Windowed sinc filter, split into one set of taps per output phase
+class polyphase_resampler : public resampler {
+    public:
+    struct filter_bank {
+        // Output rate / input rate, reduced
+        int64_t up;
+        int64_t down;
+
+        // Taps per phase, a multiple of 4
+        size_t taps;
+
+        // up phases of taps coefficients each
+        std::vector<float> coefs;
+    };
+
+    private:
+    size_t _channels;
+    std::shared_ptr<const filter_bank> _bank;
+
+    // Planar input not fully used yet, starting taps / 2 frames before the next output
+    std::vector<std::vector<float>> _buf;
+
+    // Position of the next output in _buf, as a frame and a phase
+    int64_t _index;
+    int64_t _phase = 0;
+
+    // To know when flush is done
+    int64_t _consumed = 0;
+    int64_t _produced = 0;
+
+    public:
+    polyphase_resampler(size_t channels, int64_t in_rate, int64_t out_rate, quality quality);
+
+    // Filter bank for a rate pair, shared between all resamplers using the same one
+    static std::shared_ptr<const filter_bank> bank(int64_t in_rate, int64_t out_rate, quality quality);
+
+    int64_t max_output(int64_t in_frames) const override;
+    int64_t process(const float* in, int64_t in_frames, float* out, int64_t out_frames) override;
+    int64_t flush(float* out, int64_t out_frames) override;
+    void reset() override;
+
+    private:
+    // Produce output from what's buffered
+    int64_t _run(float* out, int64_t out_frames, int64_t limit);
+};
+
+// Wraps swresample, for comparison and as a fallback
+class swr_resampler : public resampler {
+    ffmpeg::swresample::context::audio_info _in;
+    ffmpeg::swresample::context::audio_info _out;
+
+    std::unique_ptr<ffmpeg::swresample::context> _swr;
+
+    public:
+    swr_resampler(size_t channels, int64_t in_rate, int64_t out_rate);
+
+    int64_t max_output(int64_t in_frames) const override;
+    int64_t process(const float* in, int64_t in_frames, float* out, int64_t out_frames) override;
+    int64_t flush(float* out, int64_t out_frames) override;
+    void reset() override;
+};
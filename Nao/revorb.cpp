@@ -0,0 +1,408 @@
+#include "revorb.h"
+
+#include "ogg_stream.h"
+#include "filesystem_utils.h"
+#include "thread_pool.h"
+
+#include <nao/logging.h>
+
+#include <latch>
+#include <cctype>
+#include <fstream>
+
+namespace detail {
+    // Accepts and drops everything, for the check pass
+    class null_streambuf : public std::streambuf {
+        protected:
+        int_type overflow(int_type ch) override {
+            return traits_type::not_eof(ch);
+        }
+
+        std::streamsize xsputn(const char*, std::streamsize count) override {
+            return count;
+        }
+    };
+
+    // Run every page of an in-memory file through the filter
+    static bool revorb_pages(revorb_filter& filter, const unsigned char* data, size_t size, binary_ostream& out) {
+        size_t pos = 0;
+
+        while (pos < size) {
+            std::streamsize page = revorb_filter::page_size(data + pos, size - pos);
+            CHECK(page > 0);
+
+            CHECK(filter.write(data + pos, static_cast<size_t>(page), out));
+
+            pos += static_cast<size_t>(page);
+        }
+
+        return filter.stats().pages > 0;
+    }
+}
+
+namespace revorb {
+    bool revorb(const istream_ptr& in, const ostream_ptr& out, revorb_stats* stats) {
+        auto start = std::chrono::steady_clock::now();
+
+        revorb_filter filter;
+
+        // Largest possible page
+        std::vector<unsigned char> page(27 + 255 + (255 * 255));
+
+        while (true) {
+            in->read(page.data(), 27);
+            if (in->gcount() == 0) {
+                break;
+            }
+
+            CHECK(in->gcount() == 27);
+
+            size_t segments = page[26];
+            in->read(page.data() + 27, segments);
+            CHECK(in->gcount() == static_cast<std::streamsize>(segments));
+
+            size_t body = 0;
+            for (size_t i = 0; i < segments; ++i) {
+                body += page[27 + i];
+            }
+
+            in->read(page.data() + 27 + segments, body);
+            CHECK(in->gcount() == static_cast<std::streamsize>(body));
+
+            CHECK(filter.write(page.data(), 27 + segments + body, *out));
+        }
+
+        CHECK(filter.stats().pages > 0);
+
+        auto end = std::chrono::steady_clock::now();
+        nao::coutln("Revorbed in", (end - start).count() / 1e6, "ms,", filter.stats().pages_rewritten,
+            "of", filter.stats().pages, "pages rewritten");
+
+        if (stats) {
+            *stats = filter.stats();
+        }
+
+        return true;
+    }
+
+    file_result revorb_file(const std::filesystem::path& path) {
+        auto start = std::chrono::steady_clock::now();
+
+        file_result result {
+            .path = path,
+            .status = file_status::failed
+        };
+
+        auto finish = [&](file_status status) {
+            result.status = status;
+            result.time = std::chrono::steady_clock::now() - start;
+            return result;
+        };
+
+        std::filesystem::path temp = path;
+        temp += ".tmp";
+
+        // Never leave a partial temporary file behind
+        auto fail = [&] {
+            std::error_code ec;
+            std::filesystem::remove(temp, ec);
+            return finish(file_status::failed);
+        };
+
+        {
+            fs_utils::mapped_file file(path);
+            if (!file) {
+                return finish(file_status::failed);
+            }
+
+            // Check first, most files don't need any changes and are never written
+            {
+                revorb_filter filter;
+
+                detail::null_streambuf sink;
+                binary_ostream null(std::make_shared<std::ostream>(&sink));
+
+                if (!detail::revorb_pages(filter, file.data(), file.size(), null)) {
+                    return finish(file_status::failed);
+                }
+
+                result.stats = filter.stats();
+
+                if (result.stats.pages_rewritten == 0) {
+                    return finish(file_status::skipped);
+                }
+            }
+
+            auto stream = std::make_shared<std::ofstream>(temp, std::ios::binary | std::ios::trunc);
+            if (!*stream) {
+                return fail();
+            }
+
+            // The check pass already verified the pages
+            revorb_filter filter(false);
+            binary_ostream out(stream);
+
+            if (!detail::revorb_pages(filter, file.data(), file.size(), out)) {
+                return fail();
+            }
+
+            stream->flush();
+            stream->close();
+
+            if (!stream->good()) {
+                return fail();
+            }
+
+            // Only granule positions and CRCs change, every page keeps its size
+            std::error_code ec;
+            if (std::filesystem::file_size(temp, ec) != file.size() || ec) {
+                return fail();
+            }
+        }
+
+        // Both files are closed, swap in the new one
+        std::error_code ec;
+        std::filesystem::rename(temp, path, ec);
+
+        if (ec) {
+            return fail();
+        }
+
+        return finish(file_status::fixed);
+    }
+
+    std::vector<file_result> revorb_directory(const std::filesystem::path& dir, size_t threads) {
+        std::vector<std::filesystem::path> files;
+
+        // Unreadable directories and entries are skipped instead of throwing halfway through the walk
+        std::error_code ec;
+        auto it = std::filesystem::recursive_directory_iterator(dir,
+            std::filesystem::directory_options::skip_permission_denied, ec);
+
+        for (; !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+            std::string ext = it->path().extension().string();
+            std::ranges::transform(ext, ext.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+
+            std::error_code type_ec;
+            if (it->is_regular_file(type_ec) && ext == ".ogg") {
+                files.push_back(it->path());
+            }
+        }
+
+        if (ec) {
+            nao::coutln("listing", dir.string(), "stopped early:", ec.message());
+        }
+
+        std::vector<file_result> results(files.size());
+
+        if (files.empty()) {
+            return results;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        {
+            // Each worker only ever holds one mapped file and a single page
+            thread_pool pool(std::min(threads ? threads : thread_pool::pool_size(), files.size()));
+            std::latch done(static_cast<std::ptrdiff_t>(files.size()));
+
+            for (size_t i = 0; i < files.size(); ++i) {
+                pool.push([&, i] {
+                    try {
+                        results[i] = revorb_file(files[i]);
+                    } catch (const std::exception& e) {
+                        nao::coutln("revorb of", files[i].string(), "failed:", e.what());
+                        results[i] = { .path = files[i], .status = file_status::failed };
+                    }
+
+                    done.count_down();
+                });
+            }
+
+            done.wait();
+        }
+
+        size_t fixed = 0;
+        size_t skipped = 0;
+        size_t failed = 0;
+
+        for (const auto& res : results) {
+            const char* status = "failed";
+            switch (res.status) {
+                case file_status::fixed: status = "fixed"; ++fixed; break;
+                case file_status::skipped: status = "skipped"; ++skipped; break;
+                case file_status::failed: ++failed; break;
+            }
+
+            nao::coutln(res.path.string(), status, "in", res.time.count() / 1e6, "ms,",
+                res.stats.pages_rewritten, "of", res.stats.pages, "pages rewritten");
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        nao::coutln("Revorbed", files.size(), "files in", (end - start).count() / 1e6, "ms,",
+            fixed, "fixed,", skipped, "skipped,", failed, "failed");
+
+        return results;
+    }
+}
+
+revorb_filter::revorb_filter(bool verify) : _verify { verify } {
+
+}
+
+std::streamsize revorb_filter::page_size(const unsigned char* data, size_t size) {
+    if (size < 27) {
+        return 0;
+    }
+
+    if (std::string_view(reinterpret_cast<const char*>(data), 4) != "OggS" || data[4] != 0) {
+        return -1;
+    }
+
+    size_t segments = data[26];
+    if (size < (27 + segments)) {
+        return 0;
+    }
+
+    size_t total = 27 + segments;
+    for (size_t i = 0; i < segments; ++i) {
+        total += data[27 + i];
+    }
+
+    return (size < total) ? 0 : static_cast<std::streamsize>(total);
+}
+
+bool revorb_filter::write(const unsigned char* page, size_t size, binary_ostream& out) {
+    CHECK(page_size(page, size) == static_cast<std::streamsize>(size));
+
+    constexpr unsigned char zero_crc[4] { };
+
+    if (_verify) {
+        uint32_t crc = ogg_stream::crc(0, page, 22);
+        crc = ogg_stream::crc(crc, zero_crc, 4);
+        crc = ogg_stream::crc(crc, page + 26, size - 26);
+
+        uint32_t stored = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            stored |= uint32_t { page[22 + i] } << (i * 8);
+        }
+
+        CHECK(crc == stored);
+    }
+
+    // Continued packet flag has to match what the last page left off with
+    CHECK(((page[5] & 0x01) != 0) == _in_packet);
+
+    size_t segments = page[26];
+    const unsigned char* lacing = page + 27;
+    const unsigned char* body = lacing + segments;
+
+    // Granule of the last packet finished on this page
+    int64_t granule = -1;
+
+    for (size_t i = 0; i < segments; ++i) {
+        size_t len = lacing[i];
+
+        if (!_in_packet) {
+            _header_packet.clear();
+            _have_first = false;
+        }
+
+        if (_headers < 3) {
+            _header_packet.insert(_header_packet.end(), body, body + len);
+        } else if (!_have_first && len > 0) {
+            _first_byte = *body;
+            _have_first = true;
+        }
+
+        body += len;
+
+        if (len < 255) {
+            CHECK(_packet_done());
+
+            granule = _granulepos;
+            _in_packet = false;
+        } else {
+            _in_packet = true;
+        }
+    }
+
+    int64_t stored = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        stored |= int64_t { page[6 + i] } << (i * 8);
+    }
+
+    ++_stats.pages;
+
+    if (stored == granule) {
+        out.write(reinterpret_cast<const char*>(page), static_cast<std::streamsize>(size));
+        return true;
+    }
+
+    _scratch.assign(page, page + size);
+
+    for (size_t i = 0; i < 8; ++i) {
+        _scratch[6 + i] = static_cast<unsigned char>((static_cast<uint64_t>(granule) >> (i * 8)) & 0xFF);
+    }
+
+    std::copy_n(zero_crc, 4, _scratch.data() + 22);
+
+    uint32_t crc = ogg_stream::crc(0, _scratch.data(), size);
+    for (size_t i = 0; i < 4; ++i) {
+        _scratch[22 + i] = static_cast<unsigned char>((crc >> (i * 8)) & 0xFF);
+    }
+
+    out.write(reinterpret_cast<const char*>(_scratch.data()), static_cast<std::streamsize>(size));
+
+    ++_stats.pages_rewritten;
+
+    return true;
+}
+
+const revorb::revorb_stats& revorb_filter::stats() const {
+    return _stats;
+}
+
+bool revorb_filter::_packet_done() {
+    ++_stats.packets;
+
+    if (_headers < 3) {
+        ogg_packet packet {
+            .packet = _header_packet.data(),
+            .bytes = static_cast<long>(_header_packet.size()),
+            .b_o_s = (_headers == 0) ? 1 : 0,
+            .e_o_s = 0,
+            .granulepos = 0,
+            .packetno = _headers
+        };
+
+        CHECK(_vc.headerin(packet));
+        ++_headers;
+
+        return true;
+    }
+
+    // The packet type and mode number both fit into the first byte
+    ogg_packet packet {
+        .packet = &_first_byte,
+        .bytes = _have_first ? 1 : 0,
+        .b_o_s = 0,
+        .e_o_s = 0,
+        .granulepos = 0,
+        .packetno = 0
+    };
+
+    long bs = _vc.blocksize(packet);
+    if (bs <= 0) {
+        // Not an audio packet, doesn't advance the granule position
+        return true;
+    }
+
+    if (_last_bs > 0) {
+        _granulepos += (_last_bs + bs) / 4;
+    }
+
+    _last_bs = bs;
+
+    return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "binary_stream.h"
+#include "vorbis_encoder.h"
+
+#include <vector>
+#include <filesystem>
+#include <chrono>
+
+namespace revorb {
+    struct revorb_stats {
+        int64_t pages;
+
+        // Pages whose granule position had to be changed
+        int64_t pages_rewritten;
+        int64_t packets;
+    };
+
+    // Recompute the granule positions of an Ogg Vorbis file, pages that are already correct are copied unchanged
+    bool revorb(const istream_ptr& in, const ostream_ptr& out, revorb_stats* stats = nullptr);
+
+    enum class file_status {
+        fixed,
+
+        // Granule positions were already correct, the file was left alone
+        skipped,
+        failed
+    };
+
+    struct file_result {
+        std::filesystem::path path;
+        file_status status;
+        std::chrono::nanoseconds time;
+        revorb_stats stats;
+    };
+
+    // Revorb a single file in place, replacing it only once the new file is complete
+    file_result revorb_file(const std::filesystem::path& path);
+
+    // Revorb every .ogg file in a directory tree, 0 threads uses one per core
+    std::vector<file_result> revorb_directory(const std::filesystem::path& dir, size_t threads = 0);
+}
+
+// Recomputes granule positions one page at a time, keeping the original page layout
+class revorb_filter {
+    vorbis_encoder _vc;
+
+    // Check the CRC of incoming pages
+    bool _verify;
+
+    // Header packets are needed in full, audio packets only for their first byte
+    int _headers = 0;
+    std::vector<unsigned char> _header_packet;
+    unsigned char _first_byte = 0;
+    bool _have_first = false;
+
+    // Whether the last page ended in the middle of a packet
+    bool _in_packet = false;
+
+    int64_t _granulepos = 0;
+    long _last_bs = 0;
+
+    revorb::revorb_stats _stats { };
+
+    // Copy of a page that needs to be changed
+    std::vector<unsigned char> _scratch;
+
+    public:
+    explicit revorb_filter(bool verify = true);
+
+    // Size of the page at the start of data, 0 if more data is needed, -1 if it's not an Ogg page
+    static std::streamsize page_size(const unsigned char* data, size_t size);
+
+    // Write a single complete page, as-is if its granule position is already correct
+    bool write(const unsigned char* page, size_t size, binary_ostream& out);
+
+    const revorb::revorb_stats& stats() const;
+
+    private:
+    bool _packet_done();
+};
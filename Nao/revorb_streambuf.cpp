@@ -0,0 +1,68 @@
+#include "revorb_streambuf.h"
+
+revorb_streambuf::revorb_streambuf(const ostream_ptr& out, bool verify) : _filter { verify }, _out { out } {
+
+}
+
+const revorb_filter& revorb_streambuf::filter() const {
+    return _filter;
+}
+
+bool revorb_streambuf::good() const {
+    return !_failed && _pending.empty();
+}
+
+revorb_streambuf::int_type revorb_streambuf::overflow(int_type ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof())) {
+        return traits_type::not_eof(ch);
+    }
+
+    char c = traits_type::to_char_type(ch);
+    if (xsputn(&c, 1) != 1) {
+        return traits_type::eof();
+    }
+
+    return ch;
+}
+
+std::streamsize revorb_streambuf::xsputn(const char* s, std::streamsize count) {
+    if (_failed) {
+        return 0;
+    }
+
+    auto data = reinterpret_cast<const unsigned char*>(s);
+    auto size = static_cast<size_t>(count);
+
+    if (_pending.empty()) {
+        // Whole pages are filtered straight from the caller's buffer, only the remainder is kept
+        size_t used = _consume(data, size);
+        _pending.assign(data + used, data + size);
+    } else {
+        _pending.insert(_pending.end(), data, data + size);
+
+        size_t used = _consume(_pending.data(), _pending.size());
+        _pending.erase(_pending.begin(), _pending.begin() + used);
+    }
+
+    return _failed ? 0 : count;
+}
+
+size_t revorb_streambuf::_consume(const unsigned char* data, size_t size) {
+    size_t used = 0;
+
+    while (used < size) {
+        std::streamsize page = revorb_filter::page_size(data + used, size - used);
+        if (page == 0) {
+            break;
+        }
+
+        if (page < 0 || !_filter.write(data + used, static_cast<size_t>(page), *_out)) {
+            _failed = true;
+            break;
+        }
+
+        used += static_cast<size_t>(page);
+    }
+
+    return used;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "revorb.h"
+
+#include <streambuf>
+
+// Output streambuf which runs whole Ogg pages through a revorb_filter before passing them on
+class revorb_streambuf : public std::streambuf {
+    revorb_filter _filter;
+    ostream_ptr _out;
+
+    // Start of a page that was only partially written
+    std::vector<unsigned char> _pending;
+    bool _failed = false;
+
+    public:
+    explicit revorb_streambuf(const ostream_ptr& out, bool verify = true);
+
+    const revorb_filter& filter() const;
+
+    // No invalid data was written and no partial page is left over
+    bool good() const;
+
+    protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char* s, std::streamsize count) override;
+
+    private:
+    // Filter as many whole pages as possible, returns the number of bytes used
+    size_t _consume(const unsigned char* data, size_t size);
+};
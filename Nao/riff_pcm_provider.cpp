@@ -0,0 +1,98 @@
+#include "riff_pcm_provider.h"
+
+#include "utils.h"
+
+riff_pcm_provider::riff_pcm_provider(const istream_ptr& stream, const wwriff::wem_info& info)
+    : pcm_provider(stream), _info { info } {
+    ASSERT(supports(info));
+
+    _sample_size = info.bits / 8;
+
+    switch (info.bits) {
+        case 8:  _fmt = sample_format::uint8; break;
+        case 16: _fmt = sample_format::int16; break;
+
+        // 24-bit samples are widened
+        case 24:
+        case 32: _fmt = sample_format::int32; break;
+        default: _fmt = sample_format::none; break;
+    }
+
+    _frames = info.data_size / info.align;
+}
+
+bool riff_pcm_provider::supports(const wwriff::wem_info& info) {
+    switch (info.bits) {
+        case 8: case 16: case 24: case 32: break;
+        default: return false;
+    }
+
+    return info.channels > 0 && info.rate > 0 && info.align == (info.channels * info.bits / 8);
+}
+
+pcm_samples riff_pcm_provider::get_samples() {
+    const int64_t frames = std::min(frames_per_read, _frames - _pos);
+    const uint64_t layout = channel_layout();
+
+    if (frames <= 0) {
+        return { _fmt, 0, static_cast<uint8_t>(_info.channels), layout };
+    }
+
+    pcm_samples samples { buffers, _fmt, static_cast<uint64_t>(frames), static_cast<uint8_t>(_info.channels), layout };
+
+    const auto bytes = static_cast<std::streamsize>(frames * _info.align);
+
+    // Matching formats are read right into the output
+    stream->seekg(_info.data_offset + (_pos * _info.align));
+    stream->read(samples.data(), bytes);
+
+    if (stream->gcount() != bytes) {
+        throw pcm_decode_exception("data chunk ends early");
+    }
+
+    if (_info.bits == 24) {
+        // Widen in place, from the back so nothing is overwritten before it's read
+        auto data = reinterpret_cast<unsigned char*>(samples.data());
+        for (int64_t i = samples.samples() - 1; i >= 0; --i) {
+            const unsigned char* src = data + (i * 3);
+            uint32_t val = (uint32_t { src[0] } << 8) | (uint32_t { src[1] } << 16) | (uint32_t { src[2] } << 24);
+            std::memcpy(data + (i * 4), &val, sizeof(val));
+        }
+    }
+
+    _pos += frames;
+
+    return samples;
+}
+
+int64_t riff_pcm_provider::rate() {
+    return _info.rate;
+}
+
+int64_t riff_pcm_provider::channels() {
+    return _info.channels;
+}
+
+uint64_t riff_pcm_provider::channel_layout() {
+    return samples::channel_layout(_info.channel_mask, _info.channels);
+}
+
+std::string riff_pcm_provider::name() {
+    return "PCM " + std::to_string(_info.bits) + "-bit";
+}
+
+std::chrono::nanoseconds riff_pcm_provider::duration() {
+    return std::chrono::nanoseconds { _frames * 1'000'000'000 / _info.rate };
+}
+
+std::chrono::nanoseconds riff_pcm_provider::pos() {
+    return std::chrono::nanoseconds { _pos * 1'000'000'000 / _info.rate };
+}
+
+void riff_pcm_provider::seek(std::chrono::nanoseconds pos) {
+    _pos = std::clamp<int64_t>(pos.count() * _info.rate / 1'000'000'000, 0, _frames);
+}
+
+sample_format riff_pcm_provider::format() {
+    return _fmt;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "pcm_provider.h"
+
+#include "wwriff.h"
+
+// Reads integer PCM straight from a RIFF data chunk
+class riff_pcm_provider : public pcm_provider {
+    // Frames returned per get_samples call
+    static constexpr int64_t frames_per_read = 2048;
+
+    wwriff::wem_info _info;
+
+    sample_format _fmt;
+
+    // Bytes per sample in the file
+    size_t _sample_size;
+    int64_t _frames;
+
+    // Next frame to be returned
+    int64_t _pos = 0;
+
+    public:
+    riff_pcm_provider(const istream_ptr& stream, const wwriff::wem_info& info);
+
+    // Whether samples with this bit depth can be read
+    static bool supports(const wwriff::wem_info& info);
+
+    pcm_samples get_samples() override;
+    int64_t rate() override;
+    int64_t channels() override;
+    uint64_t channel_layout() override;
+    std::string name() override;
+
+    std::chrono::nanoseconds duration() override;
+    std::chrono::nanoseconds pos() override;
+    void seek(std::chrono::nanoseconds pos) override;
+
+    sample_format format() override;
+};
@@ -2,7 +2,7 @@
 
 #include "utils.h"
 
-#include <numeric>
+#include <algorithm>
 
 namespace detail {
     void callback_fwd(void* userdata, uint8_t* buffer, int len) {
@@ -72,43 +72,21 @@ namespace sdl {
         }
 
         void device::_callback(uint8_t* buffer, size_t len) {
-            size_t bytes_present = std::accumulate(_cb_stack.begin(), _cb_stack.end(), size_t { 0 },
-                [](size_t val, const std::vector<char>& vec) { return val + vec.size(); });
-
-            while (bytes_present < len) {
-                auto samples = _cb();
-
-                if (samples.empty()) {
-                    // End of file
-                    _cb_stack.push_back(std::vector<char>(len - bytes_present, _spec.silence));
-                } else {
-                    _cb_stack.push_back(std::move(samples));
-                }
-                bytes_present += _cb_stack.back().size();
-            }
-
-            size_t bytes_left = len;
-            char* cur = reinterpret_cast<char*>(buffer);
-            while (bytes_left > 0) {
-                auto& data = _cb_stack.front();
-                if (bytes_left >= data.size()) {
-                    // Whole vector can fit
-                    std::copy(data.begin(), data.end(), cur);
-
-                    cur += data.size();
-
-                    bytes_left -= data.size();
-
-                    _cb_stack.pop_front();
-                } else {
-                    // Truncate this vector
-                    std::copy_n(data.begin(), bytes_left, cur);
-
-                    data = std::vector<char> { data.begin() + bytes_left, data.end() };
+            // Samples go straight into SDL's buffer, nothing is allocated or kept between calls
+            auto dest = reinterpret_cast<char*>(buffer);
+            size_t filled = 0;
 
+            while (filled < len) {
+                size_t written = _cb(dest + filled, len - filled);
+                if (written == 0) {
                     break;
                 }
+
+                filled += written;
             }
+
+            // End of file or nothing ready yet
+            std::fill_n(dest + filled, len - filled, static_cast<char>(_spec.silence));
         }
     }
 }
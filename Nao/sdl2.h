@@ -3,7 +3,6 @@
 #include <cstdint>
 
 #include <functional>
-#include <deque>
 
 #include <SDL.h>
 
@@ -36,15 +35,14 @@ namespace sdl {
     namespace audio {
         class device {
             public:
-            // Return the byte array containing the samples
-            using callback = std::function<std::vector<char>()>;
+            // Write up to len bytes of samples to the buffer and return the number of bytes written, 0 if there are none
+            using callback = std::function<size_t(char* buffer, size_t len)>;
 
             private:
             subsystem_lock _lock { SDL_INIT_AUDIO };
 
             callback _cb;
             std::function<void(uint8_t*, size_t)> _cb_fwd;
-            std::deque<std::vector<char>> _cb_stack;
 
             SDL_AudioSpec _spec;
             SDL_AudioDeviceID _device;
@@ -0,0 +1,328 @@
+#include "spectrogram.h"
+
+#include "fft.h"
+#include "pcm_reader.h"
+#include "thread_pool.h"
+
+#include <emmintrin.h>
+
+#include <array>
+#include <numbers>
+#include <numeric>
+#include <cmath>
+
+namespace detail {
+    // Columns transformed per task
+    static constexpr size_t slice_columns = 128;
+
+    // Decoded slices waiting for a worker, per worker, to bound memory use
+    static constexpr size_t slices_per_thread = 2;
+
+    // Mono samples of a run of columns, and their spectra once transformed
+    struct slice {
+        std::vector<float> samples;
+        size_t columns;
+        std::vector<float> levels;
+    };
+
+    // 10 * log10(max(power * scale, floor)), from the exponent and a series for the log of the mantissa, within 0.001 dB
+    static void to_db(float* data, size_t count, float scale, float floor) {
+        const __m128 vscale = _mm_set1_ps(scale);
+        const __m128 vmin = _mm_set1_ps(1e-30f);
+        const __m128 vfloor = _mm_set1_ps(floor);
+        const __m128 one = _mm_set1_ps(1.f);
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const __m128 val = _mm_max_ps(_mm_mul_ps(_mm_loadu_ps(data + i), vscale), vmin);
+            const __m128i bits = _mm_castps_si128(val);
+
+            const __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+            const __m128 mantissa = _mm_castsi128_ps(
+                _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+
+            // ln(m) = 2 * atanh((m - 1) / (m + 1)), t stays below 1 / 3
+            const __m128 t = _mm_div_ps(_mm_sub_ps(mantissa, one), _mm_add_ps(mantissa, one));
+            const __m128 t2 = _mm_mul_ps(t, t);
+
+            __m128 series = _mm_add_ps(_mm_set1_ps(2.f / 5.f), _mm_mul_ps(t2, _mm_set1_ps(2.f / 7.f)));
+            series = _mm_add_ps(_mm_set1_ps(2.f / 3.f), _mm_mul_ps(t2, series));
+            series = _mm_add_ps(_mm_set1_ps(2.f), _mm_mul_ps(t2, series));
+
+            const __m128 ln_mantissa = _mm_mul_ps(t, series);
+
+            // 10 * log10(2) and 10 / ln(10)
+            const __m128 db = _mm_add_ps(_mm_mul_ps(exponent, _mm_set1_ps(3.0103f)), _mm_mul_ps(ln_mantissa, _mm_set1_ps(4.3429448f)));
+
+            _mm_storeu_ps(data + i, _mm_max_ps(db, vfloor));
+        }
+
+        for (; i < count; ++i) {
+            data[i] = std::max(10.f * std::log10(std::max(data[i] * scale, 1e-30f)), floor);
+        }
+    }
+
+    static std::vector<float> make_window(spectrogram_window type, size_t size) {
+        std::vector<float> result(size);
+
+        for (size_t i = 0; i < size; ++i) {
+            // Periodic windows, which overlap-add evenly at the usual hops
+            const double phase = 2. * std::numbers::pi * static_cast<double>(i) / static_cast<double>(size);
+
+            switch (type) {
+                case spectrogram_window::hann: result[i] = static_cast<float>(.5 - (.5 * std::cos(phase))); break;
+                case spectrogram_window::hamming: result[i] = static_cast<float>(.54 - (.46 * std::cos(phase))); break;
+                case spectrogram_window::blackman:
+                    result[i] = static_cast<float>(.42 - (.5 * std::cos(phase)) + (.08 * std::cos(2. * phase)));
+                    break;
+                default: result[i] = 1.f; break;
+            }
+        }
+
+        return result;
+    }
+
+    // Black through blue, purple, red and yellow to white
+    static const std::array<uint32_t, 256>& palette() {
+        static const std::array<uint32_t, 256> colours = [] {
+            static constexpr std::array<std::array<float, 3>, 7> stops { {
+                { 0.f, 0.f, 0.f },
+                { 0.f, 0.f, .5f },
+                { .5f, 0.f, .6f },
+                { 1.f, 0.f, 0.f },
+                { 1.f, .5f, 0.f },
+                { 1.f, 1.f, 0.f },
+                { 1.f, 1.f, 1.f }
+            } };
+
+            std::array<uint32_t, 256> result { };
+            for (size_t i = 0; i < result.size(); ++i) {
+                const float pos = static_cast<float>(i) * static_cast<float>(stops.size() - 1) / 255.f;
+                const size_t stop = std::min(static_cast<size_t>(pos), stops.size() - 2);
+                const float t = pos - static_cast<float>(stop);
+
+                uint32_t pixel = 0xff000000;
+                for (size_t c = 0; c < 3; ++c) {
+                    const float val = (stops[stop][c] * (1.f - t)) + (stops[stop + 1][c] * t);
+                    pixel |= static_cast<uint32_t>(std::lrint(val * 255.f)) << (16 - (c * 8));
+                }
+
+                result[i] = pixel;
+            }
+
+            return result;
+        }();
+
+        return colours;
+    }
+}
+
+spectrogram spectrogram::compute(const pcm_provider_ptr& provider, const spectrogram_settings& options, size_t threads, const std::atomic<bool>* cancel) {
+    ASSERT(options.hop > 0);
+
+    const real_fft fft { options.size };
+    const size_t size = options.size;
+    const size_t hop = options.hop;
+    const size_t bins = fft.bins();
+
+    const std::vector<float> window = detail::make_window(options.window, size);
+
+    // Full scale sine reads 0 dBFS
+    const double window_sum = std::accumulate(window.begin(), window.end(), 0.);
+    const auto scale = static_cast<float>(4. / (window_sum * window_sum));
+
+    auto transform = [&](detail::slice& slice) {
+        std::vector<float> frame(size);
+        std::vector<float> re(bins);
+        std::vector<float> im(bins);
+
+        slice.levels.resize(slice.columns * bins);
+
+        for (size_t col = 0; col < slice.columns; ++col) {
+            const float* in = slice.samples.data() + (col * hop);
+            std::transform(in, in + size, window.begin(), frame.begin(), std::multiplies<float> { });
+
+            float* out = slice.levels.data() + (col * bins);
+            fft.power(frame.data(), out, re.data(), im.data());
+            detail::to_db(out, bins, scale, options.floor);
+        }
+    };
+
+    pcm_reader reader { provider };
+    const auto channels = static_cast<size_t>(provider->channels());
+
+    const size_t read_frames = detail::slice_columns * hop;
+    std::vector<float> buf(read_frames * channels);
+
+    // Decoded samples not yet handed out, starting at the next column
+    std::vector<float> pending;
+
+    std::vector<std::shared_ptr<detail::slice>> slices;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t in_flight = 0;
+
+    // Declared last, so queued tasks are dropped before anything they use goes away
+    thread_pool pool { threads == 0 ? thread_pool::pool_size() : threads };
+    const size_t max_in_flight = (threads == 0 ? thread_pool::pool_size() : threads) * detail::slices_per_thread;
+
+    auto dispatch = [&](size_t columns) {
+        auto slice = std::make_shared<detail::slice>();
+        slice->columns = columns;
+        slice->samples.assign(pending.begin(), pending.begin() + static_cast<ptrdiff_t>(((columns - 1) * hop) + size));
+        slices.push_back(slice);
+
+        {
+            std::unique_lock lock { mutex };
+            cv.wait(lock, [&] { return in_flight < max_in_flight; });
+            ++in_flight;
+        }
+
+        pool.push([&, slice] {
+            transform(*slice);
+
+            std::scoped_lock lock { mutex };
+            --in_flight;
+            cv.notify_all();
+        });
+    };
+
+    const size_t slice_span = ((detail::slice_columns - 1) * hop) + size;
+    bool eof = false;
+
+    // With hops longer than the window, samples between the end of a slice and the next column are never used
+    size_t skip = 0;
+
+    while (!eof && !(cancel && *cancel)) {
+        const int64_t frames = reader.read(std::as_writable_bytes(std::span { buf }), sample_format::float32,
+            static_cast<int64_t>(read_frames));
+
+        eof = frames < static_cast<int64_t>(read_frames);
+
+        const size_t first = std::min(skip, static_cast<size_t>(frames));
+        skip -= first;
+
+        // Average of all channels
+        const size_t offset = pending.size();
+        pending.resize(offset + static_cast<size_t>(frames) - first);
+
+        for (size_t i = first; i < static_cast<size_t>(frames); ++i) {
+            const float* frame = buf.data() + (i * channels);
+            pending[offset + i - first] = std::accumulate(frame, frame + channels, 0.f) / static_cast<float>(channels);
+        }
+
+        while (pending.size() >= slice_span) {
+            dispatch(detail::slice_columns);
+
+            const size_t advance = detail::slice_columns * hop;
+            const size_t used = std::min(advance, pending.size());
+
+            pending.erase(pending.begin(), pending.begin() + static_cast<ptrdiff_t>(used));
+            skip = advance - used;
+        }
+    }
+
+    // Every hop that starts before the end gets a column, zero padded
+    if (eof && !pending.empty()) {
+        const size_t columns = (pending.size() + hop - 1) / hop;
+        pending.resize(((columns - 1) * hop) + size);
+        dispatch(columns);
+    }
+
+    {
+        std::unique_lock lock { mutex };
+        cv.wait(lock, [&] { return in_flight == 0; });
+    }
+
+    if (cancel && *cancel) {
+        return { };
+    }
+
+    spectrogram result;
+    result._settings = options;
+    result._rate = provider->rate();
+    result._bins = bins;
+
+    for (const auto& slice : slices) {
+        result._data.insert(result._data.end(), slice->levels.begin(), slice->levels.end());
+        result._columns += slice->columns;
+    }
+
+    return result;
+}
+
+const spectrogram_settings& spectrogram::config() const {
+    return _settings;
+}
+
+int64_t spectrogram::rate() const {
+    return _rate;
+}
+
+size_t spectrogram::bins() const {
+    return _bins;
+}
+
+size_t spectrogram::columns() const {
+    return _columns;
+}
+
+std::span<const float> spectrogram::column(size_t index) const {
+    ASSERT(index < _columns);
+
+    return { _data.data() + (index * _bins), _bins };
+}
+
+double spectrogram::frequency(size_t bin) const {
+    return static_cast<double>(bin) * static_cast<double>(_rate) / static_cast<double>(_settings.size);
+}
+
+std::chrono::nanoseconds spectrogram::time(size_t column) const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::duration<double>(static_cast<double>(column * _settings.hop) / static_cast<double>(_rate)));
+}
+
+spectrogram::operator bool() const {
+    return _columns > 0;
+}
+
+image_data spectrogram::render(size_t first, size_t count, size_t height, float ceiling) const {
+    first = std::min(first, _columns);
+    count = std::min(count, _columns - first);
+
+    const size_t rows = (height == 0) ? _bins : height;
+    const float range = std::max(ceiling - _settings.floor, 1.f);
+    const auto& palette = detail::palette();
+
+    std::vector<char> pixels(count * rows * sizeof(uint32_t));
+    auto* out = reinterpret_cast<uint32_t*>(pixels.data());
+
+    for (size_t y = 0; y < rows; ++y) {
+        // Bottom row is DC, each row takes the loudest of its bins
+        const size_t row = rows - 1 - y;
+        const size_t lo = row * _bins / rows;
+        const size_t hi = std::max(((row + 1) * _bins) / rows, lo + 1);
+
+        for (size_t x = 0; x < count; ++x) {
+            const float* levels = _data.data() + ((first + x) * _bins);
+            const float level = *std::max_element(levels + lo, levels + hi);
+
+            const float pos = std::clamp((level - _settings.floor) / range, 0.f, 1.f);
+            out[(y * count) + x] = palette[static_cast<size_t>(pos * 255.f)];
+        }
+    }
+
+    return { AV_PIX_FMT_BGRA, { static_cast<int64_t>(count), static_cast<int64_t>(rows) }, std::move(pixels) };
+}
+
+std::vector<image_data> spectrogram::tiles(size_t width, size_t height, float ceiling) const {
+    ASSERT(width > 0);
+
+    std::vector<image_data> result;
+    for (size_t first = 0; first < _columns; first += width) {
+        result.push_back(render(first, width, height, ceiling));
+    }
+
+    return result;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "pcm_provider.h"
+#include "image_provider.h"
+
+#include <span>
+
+enum class spectrogram_window {
+    rectangular,
+    hann,
+    hamming,
+    blackman
+};
+
+struct spectrogram_settings {
+    // FFT size, a power of two
+    size_t size = 2048;
+
+    // Frames between columns, may be longer than size
+    size_t hop = 512;
+
+    spectrogram_window window = spectrogram_window::hann;
+
+    // Lowest level kept, in dBFS
+    float floor = -120.f;
+};
+
+// Short-time magnitude spectrum of the channel average, one column per hop
+class spectrogram {
+    spectrogram_settings _settings;
+    int64_t _rate = 0;
+    size_t _bins = 0;
+    size_t _columns = 0;
+
+    // dBFS, column after column
+    std::vector<float> _data;
+
+    public:
+    // Decode the provider once, transforming slices of columns on threads workers (0 for one per core) while decoding.
+    // Returns an empty spectrogram if cancelled.
+    static spectrogram compute(const pcm_provider_ptr& provider, const spectrogram_settings& options = { },
+        size_t threads = 0, const std::atomic<bool>* cancel = nullptr);
+
+    const spectrogram_settings& config() const;
+    int64_t rate() const;
+
+    size_t bins() const;
+    size_t columns() const;
+
+    std::span<const float> column(size_t index) const;
+
+    // Centre frequency of a bin in Hz, and start time of a column
+    double frequency(size_t bin) const;
+    std::chrono::nanoseconds time(size_t column) const;
+
+    operator bool() const;
+
+    // BGRA image of count columns from first, low frequencies at the bottom and levels from floor to ceiling mapped to a palette.
+    // A height of 0 uses one row per bin, otherwise rows take the peak of the bins they cover.
+    image_data render(size_t first, size_t count, size_t height = 0, float ceiling = 0.f) const;
+
+    // Whole spectrogram as consecutive images at most width columns wide
+    std::vector<image_data> tiles(size_t width, size_t height = 0, float ceiling = 0.f) const;
+};
@@ -0,0 +1,83 @@
+#include "splice_streambuf.h"
+
+splice_streambuf::splice_streambuf(std::vector<char> header, const istream_ptr& stream, std::streamoff start, std::streamsize size)
+    : _header { std::move(header) }, _stream { stream }, _start { start }, _size { size } {
+    setg(_header.data(), _header.data(), _header.data() + _header.size());
+}
+
+splice_streambuf::int_type splice_streambuf::underflow() {
+    std::streamoff cur = _cur();
+    auto header_size = static_cast<std::streamoff>(_header.size());
+
+    if (cur < header_size) {
+        // Header is served straight from memory
+        _area_pos = 0;
+        setg(_header.data(), _header.data() + cur, _header.data() + _header.size());
+
+        return traits_type::to_int_type(*gptr());
+    }
+
+    std::streamoff offset = cur - header_size;
+    if (offset >= _size) {
+        return traits_type::eof();
+    }
+
+    auto count = std::min<std::streamsize>(_size - offset, buf_size);
+    _buf.resize(buf_size);
+
+    _stream->seekg(_start + offset);
+    _stream->read(_buf.data(), count);
+
+    count = _stream->gcount();
+    if (count <= 0) {
+        return traits_type::eof();
+    }
+
+    _area_pos = cur;
+    setg(_buf.data(), _buf.data(), _buf.data() + count);
+
+    return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize splice_streambuf::showmanyc() {
+    return _total() - _cur();
+}
+
+splice_streambuf::pos_type splice_streambuf::seekoff(off_type offset, std::ios::seekdir dir, std::ios::openmode mode) {
+    switch (dir) {
+        case std::ios::cur: return seekpos(_cur() + offset, mode);
+        case std::ios::beg: return seekpos(offset, mode);
+        case std::ios::end: return seekpos(_total() + offset, mode);
+        default: break;
+    }
+
+    return pos_type(off_type(-1));
+}
+
+splice_streambuf::pos_type splice_streambuf::seekpos(pos_type pos, std::ios::openmode) {
+    std::streamoff target = pos;
+    if (target < 0 || target > _total()) {
+        return pos_type(off_type(-1));
+    }
+
+    // Inside the current get area
+    auto area_size = static_cast<std::streamoff>(std::distance(eback(), egptr()));
+    if (eback() && target >= _area_pos && target < (_area_pos + area_size)) {
+        setg(eback(), eback() + (target - _area_pos), egptr());
+        return pos;
+    }
+
+    // Empty get area at the target, filled by the next underflow
+    _area_pos = target;
+    setg(_buf.data(), _buf.data(), _buf.data());
+
+    return pos;
+}
+
+std::streamoff splice_streambuf::_cur() const {
+    return _area_pos + std::distance(eback(), gptr());
+}
+
+std::streamsize splice_streambuf::_total() const {
+    return static_cast<std::streamsize>(_header.size()) + _size;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "binary_stream.h"
+
+#include <vector>
+
+// Read-only view of an in-memory header followed by a range of another stream, nothing is copied up front
+class splice_streambuf : public std::streambuf {
+    static constexpr size_t buf_size = 65536;
+
+    std::vector<char> _header;
+
+    istream_ptr _stream;
+    std::streamoff _start;
+    std::streamsize _size;
+
+    std::vector<char> _buf;
+
+    // Position of the current get area, which is either _header or _buf
+    std::streamoff _area_pos = 0;
+
+    public:
+    splice_streambuf(std::vector<char> header, const istream_ptr& stream, std::streamoff start, std::streamsize size);
+
+    protected:
+    int_type underflow() override;
+    std::streamsize showmanyc() override;
+    pos_type seekoff(off_type offset, std::ios::seekdir dir, std::ios::openmode mode) override;
+    pos_type seekpos(pos_type pos, std::ios::openmode mode) override;
+
+    private:
+    std::streamoff _cur() const;
+    std::streamsize _total() const;
+};
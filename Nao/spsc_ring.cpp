@@ -0,0 +1,64 @@
+#include "spsc_ring.h"
+
+#include <algorithm>
+
+spsc_ring::spsc_ring(size_t capacity) : _buf(capacity) {
+
+}
+
+size_t spsc_ring::capacity() const {
+    return _buf.size();
+}
+
+size_t spsc_ring::size() const {
+    return _write.load(std::memory_order_acquire) - _read.load(std::memory_order_acquire);
+}
+
+size_t spsc_ring::free() const {
+    return capacity() - size();
+}
+
+size_t spsc_ring::write(const char* data, size_t size) {
+    const size_t write = _write.load(std::memory_order_relaxed);
+    const size_t read = _read.load(std::memory_order_acquire);
+
+    size = std::min(size, capacity() - (write - read));
+
+    // Copy in at most two parts, up to the end of the buffer and then from the start
+    const size_t offset = write % capacity();
+    const size_t first = std::min(size, capacity() - offset);
+
+    std::copy_n(data, first, _buf.data() + offset);
+    std::copy_n(data + first, size - first, _buf.data());
+
+    _write.store(write + size, std::memory_order_release);
+
+    return size;
+}
+
+void spsc_ring::clear() {
+    _clear_at.store(_write.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+size_t spsc_ring::read(char* data, size_t size) {
+    size_t read = _read.load(std::memory_order_relaxed);
+
+    const size_t clear_at = _clear_at.exchange(no_clear, std::memory_order_acq_rel);
+    if (clear_at != no_clear && clear_at > read) {
+        read = clear_at;
+    }
+
+    const size_t write = _write.load(std::memory_order_acquire);
+
+    size = std::min(size, write - read);
+
+    const size_t offset = read % capacity();
+    const size_t first = std::min(size, capacity() - offset);
+
+    std::copy_n(_buf.data() + offset, first, data);
+    std::copy_n(_buf.data(), size - first, data + first);
+
+    _read.store(read + size, std::memory_order_release);
+
+    return size;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+// Lock-free byte ring for exactly one producer thread and one consumer thread
+class spsc_ring {
+    static constexpr size_t no_clear = static_cast<size_t>(-1);
+
+    std::vector<char> _buf;
+
+    // Ever increasing positions, the index into _buf is the position modulo the capacity
+    alignas(64) std::atomic<size_t> _read = 0;
+    alignas(64) std::atomic<size_t> _write = 0;
+
+    // Write position up to which the consumer should drop data
+    std::atomic<size_t> _clear_at = no_clear;
+
+    public:
+    explicit spsc_ring(size_t capacity);
+
+    size_t capacity() const;
+
+    // Bytes that can be read, may be lower than the real value when called by the producer
+    size_t size() const;
+
+    // Bytes that can be written, may be lower than the real value when called by the consumer
+    size_t free() const;
+
+    // Producer side, writes as much as fits and returns the number of bytes written
+    size_t write(const char* data, size_t size);
+
+    // Producer side, everything written so far is dropped by the consumer before its next read
+    void clear();
+
+    // Consumer side, reads up to size bytes and returns the number of bytes read
+    size_t read(char* data, size_t size);
+};
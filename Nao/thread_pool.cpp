@@ -56,7 +56,12 @@ thread_pool::thread_pool(size_t n_threads, const std::function<void()>& before,
                 std::unique_ptr<std::function<void()>> func;
 
                 {
+                    // Another worker may have taken the task since the queue was checked
                     std::unique_lock lock(_m_queue_mutex);
+                    if (_m_queue.empty()) {
+                        break;
+                    }
+
                     func.reset(_m_queue.front());
                     _m_queue.pop();
                 }
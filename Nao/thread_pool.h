@@ -31,7 +31,7 @@ class thread_pool {
                     std::bind(std::forward<Func>(f), std::forward<Args>(args)...));
 
         {
-            std::unique_lock lock(_m_mutex);
+            std::unique_lock lock(_m_queue_mutex);
             
             _m_queue.push(new std::function<void()>([packed] {
                 (*packed)();
@@ -0,0 +1,116 @@
+#include "vector_streambuf.h"
+
+#include <algorithm>
+
+vector_streambuf::vector_streambuf(size_t reserve) {
+    _data.reserve(reserve);
+}
+
+vector_streambuf::vector_streambuf(std::vector<std::byte> data) : _data { std::move(data) } {
+    _set_get(0);
+}
+
+size_t vector_streambuf::size() const {
+    return _data.size();
+}
+
+size_t vector_streambuf::capacity() const {
+    return _data.capacity();
+}
+
+const std::vector<std::byte>& vector_streambuf::data() const {
+    return _data;
+}
+
+std::vector<std::byte> vector_streambuf::take() {
+    std::vector<std::byte> result = std::move(_data);
+
+    _data = { };
+    _put = 0;
+    setg(nullptr, nullptr, nullptr);
+
+    return result;
+}
+
+vector_streambuf::int_type vector_streambuf::overflow(int_type ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof())) {
+        return traits_type::not_eof(ch);
+    }
+
+    char c = traits_type::to_char_type(ch);
+    xsputn(&c, 1);
+
+    return ch;
+}
+
+std::streamsize vector_streambuf::xsputn(const char* s, std::streamsize count) {
+    // Storage may move, keep the read position
+    std::streamoff get = _get();
+
+    auto begin = reinterpret_cast<const std::byte*>(s);
+    auto end = begin + count;
+
+    if (_put == _data.size()) {
+        // Append, the common case
+        _data.insert(_data.end(), begin, end);
+    } else {
+        size_t overwrite = std::min<size_t>(count, _data.size() - _put);
+        std::copy_n(begin, overwrite, _data.begin() + _put);
+        _data.insert(_data.end(), begin + overwrite, end);
+    }
+
+    _put += count;
+
+    _set_get(get);
+
+    return count;
+}
+
+vector_streambuf::int_type vector_streambuf::underflow() {
+    std::streamoff get = _get();
+    if (get >= static_cast<std::streamoff>(_data.size())) {
+        return traits_type::eof();
+    }
+
+    _set_get(get);
+
+    return traits_type::to_int_type(*gptr());
+}
+
+vector_streambuf::pos_type vector_streambuf::seekoff(off_type offset, std::ios::seekdir dir, std::ios::openmode mode) {
+    std::streamoff base;
+    switch (dir) {
+        case std::ios::beg: base = 0; break;
+        case std::ios::cur: base = (mode & std::ios::out) ? static_cast<std::streamoff>(_put) : _get(); break;
+        case std::ios::end: base = _data.size(); break;
+        default: return pos_type(off_type(-1));
+    }
+
+    return seekpos(base + offset, mode);
+}
+
+vector_streambuf::pos_type vector_streambuf::seekpos(pos_type pos, std::ios::openmode mode) {
+    std::streamoff target = pos;
+    if (target < 0 || target > static_cast<std::streamoff>(_data.size())) {
+        return pos_type(off_type(-1));
+    }
+
+    if (mode & std::ios::in) {
+        _set_get(target);
+    }
+
+    if (mode & std::ios::out) {
+        _put = static_cast<size_t>(target);
+    }
+
+    return pos;
+}
+
+std::streamoff vector_streambuf::_get() const {
+    return eback() ? std::distance(eback(), gptr()) : 0;
+}
+
+void vector_streambuf::_set_get(std::streamoff pos) {
+    char* base = reinterpret_cast<char*>(_data.data());
+    setg(base, base + pos, base + _data.size());
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <streambuf>
+#include <vector>
+#include <cstddef>
+
+// Read/write streambuf backed by a std::vector, whose storage can be taken without copying
+class vector_streambuf : public std::streambuf {
+    std::vector<std::byte> _data;
+
+    // Write position
+    size_t _put = 0;
+
+    public:
+    // Empty buffer with space for at least reserve bytes
+    explicit vector_streambuf(size_t reserve = 0);
+
+    // Read from (and overwrite) existing data
+    explicit vector_streambuf(std::vector<std::byte> data);
+
+    size_t size() const;
+    size_t capacity() const;
+
+    const std::vector<std::byte>& data() const;
+
+    // Move the data out, leaving this buffer empty
+    std::vector<std::byte> take();
+
+    protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char* s, std::streamsize count) override;
+    int_type underflow() override;
+    pos_type seekoff(off_type offset, std::ios::seekdir dir, std::ios::openmode mode) override;
+    pos_type seekpos(pos_type pos, std::ios::openmode mode) override;
+
+    private:
+    std::streamoff _get() const;
+    void _set_get(std::streamoff pos);
+};
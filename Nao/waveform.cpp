@@ -0,0 +1,375 @@
+#include "waveform.h"
+
+#include "pcm_reader.h"
+
+#include <emmintrin.h>
+
+#include <nao/logging.h>
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <string_view>
+
+namespace detail {
+    static constexpr char magic[4] { 'N', 'A', 'O', 'W' };
+    static constexpr uint32_t version = 2;
+
+    // FNV-1a, 64 bits, stable between runs and builds unlike std::hash
+    static uint64_t fnv1a(std::string_view str) {
+        uint64_t hash = 0xcbf29ce484222325;
+
+        for (char c : str) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 0x100000001b3;
+        }
+
+        return hash;
+    }
+
+    // Base level peaks decoded per read
+    static constexpr int64_t peaks_per_read = 64;
+
+    // Unquantised peak, while building
+    struct peak_sum {
+        float min;
+        float max;
+        double sum_squares;
+        int64_t samples;
+    };
+
+    static peak_sum reduce(const float* data, size_t count) {
+        __m128 vmin = _mm_set1_ps(std::numeric_limits<float>::max());
+        __m128 vmax = _mm_set1_ps(std::numeric_limits<float>::lowest());
+        __m128 vsum = _mm_setzero_ps();
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 val = _mm_loadu_ps(data + i);
+
+            vmin = _mm_min_ps(vmin, val);
+            vmax = _mm_max_ps(vmax, val);
+            vsum = _mm_add_ps(vsum, _mm_mul_ps(val, val));
+        }
+
+        alignas(16) float mins[4];
+        alignas(16) float maxs[4];
+        alignas(16) float sums[4];
+        _mm_store_ps(mins, vmin);
+        _mm_store_ps(maxs, vmax);
+        _mm_store_ps(sums, vsum);
+
+        peak_sum result {
+            .min = std::min({ mins[0], mins[1], mins[2], mins[3] }),
+            .max = std::max({ maxs[0], maxs[1], maxs[2], maxs[3] }),
+            .sum_squares = static_cast<double>(sums[0]) + sums[1] + sums[2] + sums[3],
+            .samples = static_cast<int64_t>(count)
+        };
+
+        for (; i < count; ++i) {
+            result.min = std::min(result.min, data[i]);
+            result.max = std::max(result.max, data[i]);
+            result.sum_squares += static_cast<double>(data[i]) * data[i];
+        }
+
+        return result;
+    }
+
+    static peak_sum merge(const peak_sum& a, const peak_sum& b) {
+        return { std::min(a.min, b.min), std::max(a.max, b.max), a.sum_squares + b.sum_squares, a.samples + b.samples };
+    }
+
+    static waveform_peak quantise(const peak_sum& sum) {
+        const double rms = (sum.samples > 0) ? std::sqrt(sum.sum_squares / static_cast<double>(sum.samples)) : 0.;
+
+        return {
+            .min = static_cast<int16_t>(std::lrint(std::clamp(sum.min, -1.f, 1.f) * 32767.f)),
+            .max = static_cast<int16_t>(std::lrint(std::clamp(sum.max, -1.f, 1.f) * 32767.f)),
+            .rms = static_cast<uint16_t>(std::lrint(std::min(rms, 1.) * 65535.))
+        };
+    }
+}
+
+peak_pyramid peak_pyramid::build(const pcm_provider_ptr& provider, const std::atomic<bool>* cancel) {
+    pcm_reader reader { provider };
+
+    const auto channels = static_cast<size_t>(provider->channels());
+    std::vector<float> buf(base_frames * detail::peaks_per_read * channels);
+
+    std::vector<std::vector<detail::peak_sum>> sums(1);
+
+    peak_pyramid result;
+    result._rate = provider->rate();
+
+    while (true) {
+        if (cancel && *cancel) {
+            return { };
+        }
+
+        int64_t frames = reader.read(std::as_writable_bytes(std::span { buf }), sample_format::float32,
+            base_frames * detail::peaks_per_read);
+
+        for (int64_t i = 0; i < frames; i += base_frames) {
+            const int64_t count = std::min(base_frames, frames - i);
+            sums[0].push_back(detail::reduce(buf.data() + (i * channels), count * channels));
+        }
+
+        result._frames += frames;
+
+        if (frames < (base_frames * detail::peaks_per_read)) {
+            break;
+        }
+    }
+
+    // Every level halves the one below, until a single peak is left
+    while (sums.back().size() > 1) {
+        const std::vector<detail::peak_sum>& below = sums.back();
+        std::vector<detail::peak_sum> level((below.size() + 1) / 2);
+
+        for (size_t i = 0; i < level.size(); ++i) {
+            level[i] = ((i * 2) + 1 < below.size()) ? detail::merge(below[i * 2], below[(i * 2) + 1]) : below[i * 2];
+        }
+
+        sums.push_back(std::move(level));
+    }
+
+    for (const std::vector<detail::peak_sum>& level : sums) {
+        std::vector<waveform_peak>& out = result._levels.emplace_back(level.size());
+        std::transform(level.begin(), level.end(), out.begin(), detail::quantise);
+    }
+
+    return result;
+}
+
+int64_t peak_pyramid::frames() const {
+    return _frames;
+}
+
+int64_t peak_pyramid::rate() const {
+    return _rate;
+}
+
+size_t peak_pyramid::levels() const {
+    return _levels.size();
+}
+
+const std::vector<waveform_peak>& peak_pyramid::level(size_t index) const {
+    return _levels.at(index);
+}
+
+peak_pyramid::operator bool() const {
+    return !_levels.empty() && !_levels.front().empty();
+}
+
+std::vector<waveform_peak> peak_pyramid::query(int64_t first, int64_t last, size_t pixels) const {
+    std::vector<waveform_peak> result(pixels, waveform_peak { });
+
+    first = std::clamp<int64_t>(first, 0, _frames);
+    last = std::clamp<int64_t>(last, first, _frames);
+
+    if (!*this || pixels == 0 || first == last) {
+        return result;
+    }
+
+    const double frames_per_pixel = static_cast<double>(last - first) / static_cast<double>(pixels);
+
+    // Coarsest level with at least one peak per pixel, so every pixel merges only a few peaks
+    size_t index = 0;
+    while ((index + 1) < _levels.size() && static_cast<double>(base_frames << (index + 1)) <= frames_per_pixel) {
+        ++index;
+    }
+
+    const std::vector<waveform_peak>& level = _levels[index];
+    const int64_t block = base_frames << index;
+
+    for (size_t x = 0; x < pixels; ++x) {
+        const auto start = static_cast<int64_t>(static_cast<double>(first) + (static_cast<double>(x) * frames_per_pixel));
+        const auto end = static_cast<int64_t>(static_cast<double>(first) + (static_cast<double>(x + 1) * frames_per_pixel));
+
+        const auto lo = static_cast<size_t>(start / block);
+        const size_t hi = std::clamp<size_t>(static_cast<size_t>((end + block - 1) / block), lo + 1, level.size());
+
+        waveform_peak peak = level[lo];
+        double squares = static_cast<double>(peak.rms) * peak.rms;
+
+        for (size_t i = lo + 1; i < hi; ++i) {
+            peak.min = std::min(peak.min, level[i].min);
+            peak.max = std::max(peak.max, level[i].max);
+            squares += static_cast<double>(level[i].rms) * level[i].rms;
+        }
+
+        peak.rms = static_cast<uint16_t>(std::lrint(std::sqrt(squares / static_cast<double>(hi - lo))));
+        result[x] = peak;
+    }
+
+    return result;
+}
+
+bool peak_pyramid::save(const std::filesystem::path& path, const std::string& key) const {
+    // Written next to the cache file and swapped in once complete, per thread in case two build the same key
+    std::filesystem::path temp = path;
+    temp += '.' + std::to_string(std::hash<std::thread::id> { }(std::this_thread::get_id())) + ".tmp";
+
+    auto fail = [&] {
+        std::error_code ec;
+        std::filesystem::remove(temp, ec);
+        return false;
+    };
+
+    {
+        auto file = std::make_shared<std::ofstream>(temp, std::ios::binary | std::ios::trunc);
+        if (!*file) {
+            return fail();
+        }
+
+        binary_ostream out { file };
+
+        out.write(detail::magic);
+        out.write(detail::version);
+        out.write(static_cast<uint32_t>(key.size()));
+        out.write(key.data(), key.size());
+        out.write(_frames);
+        out.write(_rate);
+        out.write(static_cast<uint32_t>(_levels.size()));
+
+        for (const std::vector<waveform_peak>& level : _levels) {
+            out.write(static_cast<uint64_t>(level.size()));
+            out.write(level.data(), level.size() * sizeof(waveform_peak));
+        }
+
+        file->flush();
+        file->close();
+
+        if (!file->good()) {
+            return fail();
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp, path, ec);
+
+    if (ec) {
+        return fail();
+    }
+
+    return true;
+}
+
+bool peak_pyramid::load(const std::filesystem::path& path, const std::string& key, peak_pyramid& pyramid) {
+    // Not cached yet
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec)) {
+        return false;
+    }
+
+    binary_istream in { path };
+
+    char magic[4];
+    in.read(magic);
+    CHECK(in.gcount() == sizeof(magic) && std::equal(std::begin(magic), std::end(magic), detail::magic));
+
+    // Written by an older build, rebuilt
+    if (in.read<uint32_t>() != detail::version) {
+        return false;
+    }
+
+    const auto key_size = in.read<uint32_t>();
+    CHECK(in.good());
+
+    // Another key with the same hash
+    if (key_size != key.size()) {
+        return false;
+    }
+
+    std::string stored(key_size, '\0');
+    in.read(stored.data(), key_size);
+    CHECK(in.gcount() == static_cast<std::streamsize>(key_size));
+
+    if (stored != key) {
+        return false;
+    }
+
+    peak_pyramid result;
+    result._frames = in.read<int64_t>();
+    result._rate = in.read<int64_t>();
+
+    const auto levels = in.read<uint32_t>();
+    CHECK(in.good() && levels <= 64);
+
+    for (uint32_t i = 0; i < levels; ++i) {
+        const auto size = in.read<uint64_t>();
+        CHECK(in.good() && size <= static_cast<uint64_t>(result._frames / base_frames) + 1);
+
+        std::vector<waveform_peak>& level = result._levels.emplace_back(size);
+        in.read(level.data(), size * sizeof(waveform_peak));
+        CHECK(in.gcount() == static_cast<std::streamsize>(size * sizeof(waveform_peak)));
+    }
+
+    pyramid = std::move(result);
+    return true;
+}
+
+waveform_engine::waveform_engine(std::filesystem::path cache_dir, size_t threads)
+    : _cache_dir { std::move(cache_dir) }, _pool { threads == 0 ? thread_pool::pool_size() : threads } {
+    std::error_code ec;
+    std::filesystem::create_directories(_cache_dir, ec);
+}
+
+waveform_engine::~waveform_engine() {
+    // Running builds stop early, queued ones are dropped by the pool
+    _cancel = true;
+}
+
+void waveform_engine::request(const std::string& key, const std::function<pcm_provider_ptr()>& make_provider, const callback& done) {
+    if (pyramid_ptr cached = find(key)) {
+        // Still on a worker, so done never runs on the caller's thread
+        _pool.push([key, done, cached = std::move(cached)] {
+            done(key, cached);
+        });
+
+        return;
+    }
+
+    _pool.push([this, key, make_provider, done] {
+        auto pyramid = std::make_shared<peak_pyramid>();
+        const std::filesystem::path path = cache_path(key);
+
+        if (!peak_pyramid::load(path, key, *pyramid)) {
+            try {
+                *pyramid = peak_pyramid::build(make_provider(), &_cancel);
+            } catch (const std::exception& e) {
+                nao::coutln("waveform failed for", key, ":", e.what());
+            }
+
+            if (_cancel) {
+                return;
+            }
+
+            if (*pyramid && !pyramid->save(path, key)) {
+                nao::coutln("failed to cache waveform for", key);
+            }
+        }
+
+        {
+            std::scoped_lock lock { _mutex };
+            _memory[key] = pyramid;
+        }
+
+        done(key, pyramid);
+    });
+}
+
+waveform_engine::pyramid_ptr waveform_engine::find(const std::string& key) {
+    std::scoped_lock lock { _mutex };
+
+    auto it = _memory.find(key);
+    return (it != _memory.end()) ? it->second : nullptr;
+}
+
+std::filesystem::path waveform_engine::cache_path(const std::string& key) const {
+    std::stringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << detail::fnv1a(key) << ".peaks";
+
+    return _cache_dir / name.str();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "pcm_provider.h"
+#include "thread_pool.h"
+
+#include <filesystem>
+#include <unordered_map>
+
+// Minimum, maximum and RMS of a range of samples, quantised to 16 bits
+struct waveform_peak {
+    int16_t min;
+    int16_t max;
+    uint16_t rms;
+};
+
+// Peaks of all channels at power-of-two decimation levels, every level halving the one below
+class peak_pyramid {
+    public:
+    // Frames per peak of the first level
+    static constexpr int64_t base_frames = 256;
+
+    private:
+    int64_t _frames = 0;
+    int64_t _rate = 0;
+
+    std::vector<std::vector<waveform_peak>> _levels;
+
+    public:
+    // Decode the whole provider once, returns an empty pyramid if cancelled
+    static peak_pyramid build(const pcm_provider_ptr& provider, const std::atomic<bool>* cancel = nullptr);
+
+    int64_t frames() const;
+    int64_t rate() const;
+
+    size_t levels() const;
+    const std::vector<waveform_peak>& level(size_t index) const;
+
+    operator bool() const;
+
+    // One peak per pixel for frames [first, last), from the level closest to the zoom so the cost only depends on pixels
+    std::vector<waveform_peak> query(int64_t first, int64_t last, size_t pixels) const;
+
+    // Key is stored with the peaks, and a file saved under any other key doesn't load
+    bool save(const std::filesystem::path& path, const std::string& key) const;
+
+    // False if the file is missing, outdated or for another key
+    static bool load(const std::filesystem::path& path, const std::string& key, peak_pyramid& pyramid);
+};
+
+// Builds pyramids in parallel in the background, and keeps them on disk between runs
+class waveform_engine {
+    public:
+    using pyramid_ptr = std::shared_ptr<const peak_pyramid>;
+    using callback = std::function<void(const std::string& key, pyramid_ptr pyramid)>;
+
+    private:
+    std::filesystem::path _cache_dir;
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, pyramid_ptr> _memory;
+
+    std::atomic<bool> _cancel = false;
+
+    thread_pool _pool;
+
+    public:
+    explicit waveform_engine(std::filesystem::path cache_dir, size_t threads = 0);
+    ~waveform_engine();
+
+    // Find or build the pyramid for key, which should identify the contents (e.g. path, size and time).
+    // The provider is only made if nothing is cached, done is always called from a worker thread, even on a memory hit.
+    void request(const std::string& key, const std::function<pcm_provider_ptr()>& make_provider, const callback& done);
+
+    // The pyramid if it's in memory already
+    pyramid_ptr find(const std::string& key);
+
+    std::filesystem::path cache_path(const std::string& key) const;
+};
@@ -3,17 +3,64 @@
 #include "file_handler_factory.h"
 
 #include "wem_pcm_provider.h"
+#include "riff_pcm_provider.h"
+#include "wwise_ima_provider.h"
+#include "wwise_opus_provider.h"
 
 #include "riff.h"
+#include "wwriff.h"
 
 file_handler_tag wem_handler::tag() const {
     return TAG_PCM;
 }
 
 pcm_provider_ptr wem_handler::make_provider() {
+    wwriff::wem_info info;
+    if (!wwriff::probe(stream, info)) {
+        return std::make_shared<wem_pcm_provider>(stream);
+    }
+
+    if (info.format == 0xFFFE && riff_pcm_provider::supports(info)) {
+        // Plain PCM doesn't need FFmpeg
+        return std::make_shared<riff_pcm_provider>(stream, info);
+    }
+
+    if (wwise_ima_provider::supports(info)) {
+        return std::make_shared<wwise_ima_provider>(stream, info);
+    }
+
+    if (wwise_opus_provider::supports(info)) {
+        return std::make_shared<wwise_opus_provider>(stream, info);
+    }
+
     return std::make_shared<wem_pcm_provider>(stream);
 }
 
+pcm_metadata wem_handler::probe() {
+    wwriff::wem_info info;
+    if (!wwriff::probe(stream, info)) {
+        return pcm_file_handler::probe();
+    }
+
+    std::string codec;
+    switch (info.format) {
+        case 0xFFFF: codec = "Wwise Vorbis"; break;
+        case 0xFFFE: codec = "PCM"; break;
+        case 0x0002: codec = "Wwise IMA ADPCM"; break;
+        case 0x3040: codec = "Wwise Opus"; break;
+        default:     codec = "unknown"; break;
+    }
+
+    return {
+        .codec = codec,
+        .rate = info.rate,
+        .channels = info.channels,
+        .duration = std::chrono::nanoseconds { static_cast<int64_t>(info.sample_count) * 1'000'000'000 / info.rate },
+        .loop_start = info.loop_count ? info.loop_start : 0,
+        .loop_end = info.loop_count ? info.loop_end : 0
+    };
+}
+
 static file_handler_ptr create(const istream_ptr& stream, const std::string& path) {
     return std::make_shared<wem_handler>(stream, path);
 }
@@ -40,7 +87,9 @@ static bool supports(const istream_ptr& stream, const std::string& path) {
         fmt_chunk fmt;
         stream->read(&fmt, sizeof(fmt));
 
-        if ((hdr.size == 66 && fmt.format == 0xFFFF) || (hdr.size == 24 && fmt.format == 0xFFFE)) {
+        if ((hdr.size == 66 && fmt.format == 0xFFFF) || (hdr.size == 24 && fmt.format == 0xFFFE)
+            || (hdr.size >= sizeof(fmt_chunk) && fmt.format == 0x0002 && fmt.bits == 4)
+            || (hdr.size >= 0x24 && fmt.format == 0x3040)) {
             return true;
         }
     }
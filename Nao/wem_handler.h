@@ -9,4 +9,7 @@ class wem_handler : public pcm_file_handler {
     file_handler_tag tag() const override;
 
     pcm_provider_ptr make_provider() override;
+
+    // Read straight from the RIFF headers
+    pcm_metadata probe() override;
 };
@@ -2,6 +2,8 @@
 
 #include "riff.h"
 #include "wwriff.h"
+#include "wwriff_streambuf.h"
+#include "splice_streambuf.h"
 
 #include "utils.h"
 
@@ -37,38 +39,45 @@ namespace detail {
 
         switch (fmt.format) {
             case 0xFFFF:
+                // Convert while reading
                 stream->seekg(0);
-                ASSERT(wwriff::wwriff_to_ogg(stream, buf));
-                break;
+                return std::make_shared<binary_istream>(std::make_unique<wwriff_streambuf>(stream));
             case 0xFFFE: {
+                // Only the header changes, the rest is read from the input as-is
+                std::streamoff data_start = stream->tellg();
+                stream->seekg(0, std::ios::end);
+                std::streamsize total = stream->tellg();
+                stream->seekg(data_start);
+
+                uint16_t extra_size = stream->read<uint16_t>();
+                uint16_t valid_bits = stream->read<uint16_t>();
+                uint32_t channel_mask = stream->read<uint32_t>();
+
+                std::streamoff rest = stream->tellg();
+                ASSERT(stream->gcount() == sizeof(channel_mask) && rest <= total);
+
+                auto header = std::make_shared<std::stringstream>(std::ios::in | std::ios::out | std::ios::binary);
+                binary_ostream out(header);
+
                 riff.size += 16;
                 fmt_riff.size += 16;
 
-                buf->write(&riff, sizeof(riff));
-                buf->write(&wave, sizeof(wave));
-                buf->write(&fmt_riff, sizeof(fmt_riff));
-                buf->write(&fmt, sizeof(fmt));
-
-                uint16_t extra_size = stream->read<uint16_t>();
-                extra_size += 16;
-                buf->write(extra_size);
+                out.write(&riff, sizeof(riff));
+                out.write(&wave, sizeof(wave));
+                out.write(&fmt_riff, sizeof(fmt_riff));
+                out.write(&fmt, sizeof(fmt));
 
-                uint16_t valid_bits = stream->read<uint16_t>();
-                buf->write(valid_bits);
-                [[maybe_unused]] uint32_t channel_mask = stream->read<uint32_t>();
-                buf->write((1ui32 << fmt.channels) - 1);
+                out.write(static_cast<uint16_t>(extra_size + 16));
+                out.write(valid_bits);
+                out.write(static_cast<uint32_t>(samples::channel_layout(channel_mask, fmt.channels)));
 
                 uint8_t guid[16] = { 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
-                buf->write(&guid, sizeof(guid));
+                out.write(&guid, sizeof(guid));
 
-                char block[4096];
-                while (!stream->eof()) {
-                    stream->read(block);
+                std::string str = header->str();
 
-                    size_t bytes = std::min<size_t>(4096, stream->gcount());
-                    buf->write(block, bytes);
-                }
-                break;
+                return std::make_shared<binary_istream>(std::make_unique<splice_streambuf>(
+                    std::vector<char>(str.begin(), str.end()), stream, rest, total - rest));
             }
 
             default: break;
@@ -81,5 +90,29 @@ namespace detail {
 }
 
 wem_pcm_provider::wem_pcm_provider(const istream_ptr& stream) : ffmpeg_pcm_provider(detail::decode(stream)) {
-    
+    _wwriff = dynamic_cast<wwriff_streambuf*>(this->stream->rdbuf());
+}
+
+std::chrono::nanoseconds wem_pcm_provider::duration() {
+    if (!_wwriff) {
+        return ffmpeg_pcm_provider::duration();
+    }
+
+    // The stream size is not known up front, so FFmpeg can't find the duration
+    const wwriff_converter& conv = _wwriff->converter();
+    return std::chrono::nanoseconds {
+        static_cast<int64_t>(conv.sample_count()) * 1'000'000'000 / conv.rate() };
+}
+
+void wem_pcm_provider::seek(std::chrono::nanoseconds pos) {
+    if (!_wwriff) {
+        ffmpeg_pcm_provider::seek(pos);
+        return;
+    }
+
+    int64_t target = pos.count() * _wwriff->converter().rate() / 1'000'000'000;
+
+    // Decoding restarts at the last checkpoint before the target, then discards up to the exact sample
+    const wwriff_streambuf::checkpoint& cp = _wwriff->find(target);
+    seek_byte(cp.out_offset, std::min(cp.first_granule, target), target);
 }
@@ -2,7 +2,15 @@
 
 #include "ffmpeg_pcm_provider.h"
 
+class wwriff_streambuf;
+
 class wem_pcm_provider : public ffmpeg_pcm_provider {
+    // Set if the input is converted on the fly
+    wwriff_streambuf* _wwriff = nullptr;
+
     public:
     explicit wem_pcm_provider(const istream_ptr& stream);
+
+    std::chrono::nanoseconds duration() override;
+    void seek(std::chrono::nanoseconds pos) override;
 };
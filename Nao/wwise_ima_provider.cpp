@@ -0,0 +1,189 @@
+#include "wwise_ima_provider.h"
+
+#include "utils.h"
+
+#include <array>
+
+namespace detail {
+    static constexpr std::array<int16_t, 89> ima_steps {
+        7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+        50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+        253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+        1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+        3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+        12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+    };
+
+    static constexpr std::array<int8_t, 16> ima_index {
+        -1, -1, -1, -1, 2, 4, 6, 8,
+        -1, -1, -1, -1, 2, 4, 6, 8
+    };
+
+    // Wwise doesn't go past 8 channels, which keeps the decoder state on the stack
+    static constexpr size_t max_channels = 8;
+}
+
+wwise_ima_provider::wwise_ima_provider(const istream_ptr& stream, const wwriff::wem_info& info)
+    : pcm_provider(stream), _info { info } {
+    ASSERT(supports(info));
+
+    _block_frames = block_frames(info);
+    _blocks = info.data_size / info.align;
+    _frames = _blocks * _block_frames;
+
+    // Trailing block cut short by the end of the data chunk
+    const int64_t tail_size = (info.data_size % info.align) / info.channels;
+    if (tail_size > 4) {
+        ++_blocks;
+        _frames += (tail_size - 4) * 2;
+    }
+
+    // The header's sample count can end partway through the last block
+    if (info.sample_count > 0) {
+        _frames = std::min<int64_t>(_frames, info.sample_count);
+    }
+
+    _block_buf.resize(info.align);
+    _partial.resize(static_cast<size_t>(_block_frames) * info.channels);
+}
+
+bool wwise_ima_provider::supports(const wwriff::wem_info& info) {
+    return info.format == 0x0002 && info.bits == 4 && info.rate > 0
+        && info.channels > 0 && info.channels <= detail::max_channels
+        && info.align > 0 && (info.align % info.channels) == 0 && (info.align / info.channels) > 4;
+}
+
+int64_t wwise_ima_provider::block_frames(const wwriff::wem_info& info) {
+    // The header sample takes the place of the last nibble, which goes unused
+    return ((info.align / info.channels) - 4) * 2;
+}
+
+void wwise_ima_provider::decode_block(const unsigned char* block, size_t channels, size_t channel_size, int16_t* out) {
+    // All channels are decoded in lockstep, so the per-sample work across channels is independent
+    int32_t pred[detail::max_channels];
+    int32_t index[detail::max_channels];
+    const unsigned char* data[detail::max_channels];
+
+    for (size_t c = 0; c < channels; ++c) {
+        const unsigned char* header = block + (c * 4);
+
+        pred[c] = static_cast<int16_t>(header[0] | (header[1] << 8));
+        index[c] = std::clamp<int32_t>(header[2], 0, 88);
+
+        // Nibbles for each channel follow all the headers
+        data[c] = block + (channels * 4) + (c * (channel_size - 4));
+
+        out[c] = static_cast<int16_t>(pred[c]);
+    }
+
+    out += channels;
+
+    const size_t nibbles = ((channel_size - 4) * 2) - 1;
+
+    for (size_t i = 0; i < nibbles; ++i) {
+        for (size_t c = 0; c < channels; ++c) {
+            // Low nibble first
+            int32_t nibble = (data[c][i / 2] >> ((i & 1) * 4)) & 0xF;
+            int32_t step = detail::ima_steps[index[c]];
+
+            int32_t diff = (step >> 3)
+                + ((nibble & 1) ? (step >> 2) : 0)
+                + ((nibble & 2) ? (step >> 1) : 0)
+                + ((nibble & 4) ? step : 0);
+
+            pred[c] = std::clamp<int32_t>(pred[c] + ((nibble & 8) ? -diff : diff), -32768, 32767);
+            index[c] = std::clamp<int32_t>(index[c] + detail::ima_index[nibble], 0, 88);
+
+            out[c] = static_cast<int16_t>(pred[c]);
+        }
+
+        out += channels;
+    }
+}
+
+pcm_samples wwise_ima_provider::get_samples() {
+    const auto channels = static_cast<uint8_t>(_info.channels);
+    const uint64_t layout = channel_layout();
+
+    if (_pos >= _frames) {
+        return { sample_format::int16, 0, channels, layout };
+    }
+
+    const int64_t first = _pos / _block_frames;
+    const int64_t skip = _pos % _block_frames;
+
+    const int64_t blocks = std::min(std::max<int64_t>(target_frames / _block_frames, 1), _blocks - first);
+
+    // The last block may be short, and the sample count may end before it does
+    const int64_t frames = std::min((blocks * _block_frames) - skip, _frames - _pos);
+
+    pcm_samples samples { buffers, sample_format::int16, static_cast<uint64_t>(frames), channels, layout };
+    int16_t* out = samples.data<sample_format::int16>();
+    int64_t remaining = frames;
+
+    stream->seekg(_info.data_offset + (first * _info.align));
+
+    for (int64_t block = first; remaining > 0; ++block) {
+        const auto size = static_cast<std::streamsize>(
+            std::min<int64_t>(_info.align, _info.data_size - (block * _info.align)));
+
+        stream->read(_block_buf.data(), size);
+        if (stream->gcount() != size) {
+            throw pcm_decode_exception("data chunk ends early");
+        }
+
+        const size_t channel_size = static_cast<size_t>(size) / channels;
+        const auto block_frames = static_cast<int64_t>((channel_size - 4) * 2);
+
+        const int64_t offset = (block == first) ? skip : 0;
+        const int64_t count = std::min(block_frames - offset, remaining);
+
+        // Straight into the output unless only part of the block is wanted
+        if (offset == 0 && count == block_frames) {
+            decode_block(_block_buf.data(), channels, channel_size, out);
+        } else {
+            decode_block(_block_buf.data(), channels, channel_size, _partial.data());
+            std::copy_n(_partial.begin() + (offset * channels), count * channels, out);
+        }
+
+        out += count * channels;
+        remaining -= count;
+    }
+
+    _pos += frames;
+
+    return samples;
+}
+
+int64_t wwise_ima_provider::rate() {
+    return _info.rate;
+}
+
+int64_t wwise_ima_provider::channels() {
+    return _info.channels;
+}
+
+uint64_t wwise_ima_provider::channel_layout() {
+    return samples::channel_layout(_info.channel_mask, _info.channels);
+}
+
+std::string wwise_ima_provider::name() {
+    return "Wwise IMA ADPCM";
+}
+
+std::chrono::nanoseconds wwise_ima_provider::duration() {
+    return std::chrono::nanoseconds { _frames * 1'000'000'000 / _info.rate };
+}
+
+std::chrono::nanoseconds wwise_ima_provider::pos() {
+    return std::chrono::nanoseconds { _pos * 1'000'000'000 / _info.rate };
+}
+
+void wwise_ima_provider::seek(std::chrono::nanoseconds pos) {
+    // Blocks are independent, so any frame can be reached by decoding its block
+    _pos = std::clamp<int64_t>(pos.count() * _info.rate / 1'000'000'000, 0, _frames);
+}
+
+sample_format wwise_ima_provider::format() {
+    return sample_format::int16;
+}
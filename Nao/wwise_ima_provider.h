@@ -0,0 +1,49 @@
+#pragma once
+
+#include "pcm_provider.h"
+
+#include "wwriff.h"
+
+// Decodes Wwise's IMA ADPCM variant, where every block holds all channel headers followed by each channel's nibbles
+class wwise_ima_provider : public pcm_provider {
+    // Blocks decoded per get_samples call, at least 1
+    static constexpr int64_t target_frames = 2048;
+
+    wwriff::wem_info _info;
+
+    // Of every full block, the last one may be shorter
+    int64_t _block_frames;
+    int64_t _blocks;
+    int64_t _frames;
+
+    // Next frame to be returned
+    int64_t _pos = 0;
+
+    std::vector<unsigned char> _block_buf;
+
+    // Blocks that are only partly returned are decoded here first
+    std::vector<int16_t> _partial;
+
+    public:
+    wwise_ima_provider(const istream_ptr& stream, const wwriff::wem_info& info);
+
+    static bool supports(const wwriff::wem_info& info);
+
+    // Frames per channel in a single full block, the header sample included
+    static int64_t block_frames(const wwriff::wem_info& info);
+
+    // Decode a single block of (channel_size - 4) * 2 frames into interleaved int16 samples
+    static void decode_block(const unsigned char* block, size_t channels, size_t channel_size, int16_t* out);
+
+    pcm_samples get_samples() override;
+    int64_t rate() override;
+    int64_t channels() override;
+    uint64_t channel_layout() override;
+    std::string name() override;
+
+    std::chrono::nanoseconds duration() override;
+    std::chrono::nanoseconds pos() override;
+    void seek(std::chrono::nanoseconds pos) override;
+
+    sample_format format() override;
+};
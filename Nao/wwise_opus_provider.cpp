@@ -0,0 +1,330 @@
+#include "wwise_opus_provider.h"
+
+#include "thread_pool.h"
+#include "utils.h"
+
+#include <opus_multistream.h>
+
+#include <latch>
+
+namespace detail {
+    // Vorbis channel order mapping (RFC 7845, 5.1.1.2), indexed by channel count - 1
+    struct opus_layout {
+        int streams;
+        int coupled;
+        uint8_t mapping[8];
+    };
+
+    static constexpr opus_layout vorbis_layouts[8] {
+        { 1, 0, { 0 } },
+        { 1, 1, { 0, 1 } },
+        { 2, 1, { 0, 2, 1 } },
+        { 2, 2, { 0, 1, 2, 3 } },
+        { 3, 2, { 0, 4, 1, 2, 3 } },
+        { 4, 2, { 0, 4, 1, 2, 3, 5 } },
+        { 4, 3, { 0, 4, 1, 2, 3, 5, 6 } },
+        { 5, 3, { 0, 6, 1, 2, 3, 4, 5, 7 } }
+    };
+
+    // Vorbis order channel for every WAVE order channel, the same tables as FFmpeg's vorbis decoder
+    static constexpr uint8_t wave_order[8][8] {
+        { 0 },
+        { 0, 1 },
+        { 0, 2, 1 },
+        { 0, 1, 2, 3 },
+        { 0, 2, 1, 3, 4 },
+        { 0, 2, 1, 5, 3, 4 },
+        { 0, 2, 1, 6, 5, 3, 4 },
+        { 0, 2, 1, 7, 5, 6, 3, 4 }
+    };
+
+    // Speakers of the Vorbis layouts, as channel masks
+    static constexpr uint64_t vorbis_masks[8] {
+        AV_CH_LAYOUT_MONO,
+        AV_CH_LAYOUT_STEREO,
+        AV_CH_LAYOUT_SURROUND,
+        AV_CH_LAYOUT_QUAD,
+        AV_CH_LAYOUT_5POINT0_BACK,
+        AV_CH_LAYOUT_5POINT1_BACK,
+        AV_CH_LAYOUT_6POINT1,
+        AV_CH_LAYOUT_7POINT1
+    };
+
+    static wwise_opus_provider::decoder_ptr make_decoder(const wwise_opus_provider::stream_info& info) {
+        int err = OPUS_OK;
+        wwise_opus_provider::decoder_ptr dec { opus_multistream_decoder_create(48000, info.channels,
+            info.streams, info.coupled, info.mapping, &err), opus_multistream_decoder_destroy };
+
+        if (err != OPUS_OK) {
+            throw pcm_decode_exception(std::string("failed to create opus decoder: ") + opus_strerror(err));
+        }
+
+        return dec;
+    }
+
+    // Decode a single packet into out, which has room for capacity frames, returns the number of frames
+    static int64_t decode_packet(OpusMSDecoder* dec, const unsigned char* packet, size_t size, float* out, int64_t capacity) {
+        int frames = opus_multistream_decode_float(dec, packet, static_cast<opus_int32>(size),
+            out, static_cast<int>(capacity), 0);
+
+        if (frames < 0) {
+            throw pcm_decode_exception(std::string("failed to decode opus packet: ") + opus_strerror(frames));
+        }
+
+        return frames;
+    }
+}
+
+wwise_opus_provider::wwise_opus_provider(const istream_ptr& stream, const wwriff::wem_info& info)
+    : pcm_provider(stream) {
+    ASSERT(read_info(stream, info, _info));
+
+    _decoder = detail::make_decoder(_info);
+    _decode_buf.resize(max_packet_frames * _info.channels);
+
+    _restart(0, _info.pre_skip);
+}
+
+bool wwise_opus_provider::supports(const wwriff::wem_info& info) {
+    return info.format == 0x3040 && info.seek_offset != -1 && info.channels > 0 && info.channels <= 8;
+}
+
+bool wwise_opus_provider::read_info(const istream_ptr& stream, const wwriff::wem_info& info, stream_info& out) {
+    CHECK(supports(info));
+
+    out = {
+        .channels = info.channels,
+        .frames = info.sample_count,
+        .data_offset = info.data_offset
+    };
+
+    // fmt extension: frames per packet at 0x12, packet count at 0x1C, pre-skip at 0x20, mapping family at 0x23
+    stream->seekg(info.fmt_offset + 0x12);
+    out.packet_frames = stream->read<uint16_t>();
+
+    stream->seekg(info.fmt_offset + 0x1C);
+    auto packet_count = stream->read<uint32_t>();
+
+    stream->seekg(info.fmt_offset + 0x20);
+    out.pre_skip = stream->read<uint16_t>();
+
+    stream->seekg(info.fmt_offset + 0x23);
+    out.mapping_family = stream->read<uint8_t>();
+
+    CHECK(out.packet_frames > 0 && out.packet_frames <= max_packet_frames);
+    CHECK(info.seek_size >= static_cast<std::streamsize>(packet_count * sizeof(uint16_t)));
+
+    const auto& layout = detail::vorbis_layouts[info.channels - 1];
+    out.streams = layout.streams;
+    out.coupled = layout.coupled;
+
+    // Family 1 decodes in Vorbis order, the mapping is permuted so channels come out in WAVE order instead
+    const auto& order = detail::wave_order[info.channels - 1];
+    for (size_t c = 0; c < info.channels; ++c) {
+        out.mapping[c] = layout.mapping[order[c]];
+    }
+
+    out.layout = detail::vorbis_masks[info.channels - 1];
+
+    if (out.mapping_family == 0) {
+        // Plain mono or stereo
+        CHECK(info.channels <= 2);
+        out.streams = 1;
+        out.coupled = info.channels - 1;
+        out.layout = samples::channel_layout(info.channel_mask, info.channels);
+    }
+
+    // Packet sizes, turned into offsets
+    std::vector<uint16_t> sizes(packet_count);
+    stream->seekg(info.seek_offset);
+    stream->read(sizes);
+    CHECK(stream->gcount() == static_cast<std::streamsize>(packet_count * sizeof(uint16_t)));
+
+    out.packets.resize(packet_count + 1);
+    out.packets[0] = 0;
+    for (size_t i = 0; i < packet_count; ++i) {
+        out.packets[i + 1] = out.packets[i] + sizes[i];
+    }
+
+    CHECK(out.packets.back() <= info.data_size);
+
+    return true;
+}
+
+bool wwise_opus_provider::decode_all(const istream_ptr& stream, const wwriff::wem_info& info, std::vector<float>& out, size_t threads) {
+    stream_info si;
+    CHECK(read_info(stream, info, si));
+
+    const auto packets = static_cast<int64_t>(si.packets.size() - 1);
+    if (packets == 0) {
+        out.clear();
+        return true;
+    }
+
+    threads = std::min<size_t>(threads ? threads : thread_pool::pool_size(), static_cast<size_t>(packets));
+    const int64_t per_part = (packets + static_cast<int64_t>(threads) - 1) / static_cast<int64_t>(threads);
+
+    // All packets are read up front, so the workers never share the stream
+    std::vector<unsigned char> data(static_cast<size_t>(si.packets.back()));
+    stream->seekg(si.data_offset);
+    stream->read(data);
+    CHECK(stream->gcount() == static_cast<std::streamsize>(data.size()));
+
+    // Frame count of every packet is fixed, so each part knows where its output goes
+    std::vector<float> all(static_cast<size_t>(packets * si.packet_frames * si.channels));
+    std::atomic<bool> ok = true;
+
+    {
+        thread_pool pool(threads);
+        std::latch done(static_cast<std::ptrdiff_t>(threads));
+
+        for (size_t t = 0; t < threads; ++t) {
+            pool.push([&, t] {
+                const int64_t first = static_cast<int64_t>(t) * per_part;
+                const int64_t last = std::min(first + per_part, packets);
+
+                try {
+                    if (first >= last) {
+                        // More threads than packets
+                        done.count_down();
+                        return;
+                    }
+
+                    decoder_ptr dec = detail::make_decoder(si);
+                    std::vector<float> scratch(max_packet_frames * si.channels);
+
+                    // Warm up on the preceding packets, their output is dropped
+                    for (int64_t i = std::max<int64_t>(first - preroll_packets, 0); i < last; ++i) {
+                        const unsigned char* packet = data.data() + si.packets[i];
+                        auto size = static_cast<size_t>(si.packets[i + 1] - si.packets[i]);
+
+                        if (i < first) {
+                            detail::decode_packet(dec.get(), packet, size, scratch.data(), max_packet_frames);
+                        } else {
+                            detail::decode_packet(dec.get(), packet, size,
+                                all.data() + (i * si.packet_frames * si.channels), si.packet_frames);
+                        }
+                    }
+                } catch (const std::exception& e) {
+                    nao::coutln("opus decode failed:", e.what());
+                    ok = false;
+                }
+
+                done.count_down();
+            });
+        }
+
+        done.wait();
+    }
+
+    CHECK(ok);
+
+    // Drop the pre-skip and anything past the real end
+    const int64_t start = std::min<int64_t>(si.pre_skip, packets * si.packet_frames);
+    const int64_t end = std::min<int64_t>(start + si.frames, packets * si.packet_frames);
+
+    out.assign(all.begin() + (start * si.channels), all.begin() + (end * si.channels));
+
+    return true;
+}
+
+pcm_samples wwise_opus_provider::get_samples() {
+    const auto channels = static_cast<uint8_t>(_info.channels);
+    const auto packets = static_cast<int64_t>(_info.packets.size() - 1);
+
+    // Every packet decodes to packet_frames, so the number of frames returned is known up front
+    int64_t frames = 0;
+    int64_t last = _packet;
+
+    for (int64_t discard = _discard; last < packets && frames < target_frames && (_pos + frames) < _info.frames; ++last) {
+        const int64_t skip = std::min(discard, _info.packet_frames);
+        discard -= skip;
+
+        frames += std::min(_info.packet_frames - skip, _info.frames - _pos - frames);
+    }
+
+    pcm_samples samples { buffers, sample_format::float32, static_cast<uint64_t>(frames), channels, _info.layout };
+    float* out = samples.data<sample_format::float32>();
+
+    for (; _packet < last; ++_packet) {
+        auto size = static_cast<size_t>(_info.packets[_packet + 1] - _info.packets[_packet]);
+        _packet_buf.resize(size);
+
+        stream->seekg(_info.data_offset + _info.packets[_packet]);
+        stream->read(_packet_buf.data(), static_cast<std::streamsize>(size));
+        if (stream->gcount() != static_cast<std::streamsize>(size)) {
+            throw pcm_decode_exception("opus packet ends early");
+        }
+
+        const int64_t skip = std::min(_discard, _info.packet_frames);
+        _discard -= skip;
+
+        // Don't return anything past the end of the stream
+        const int64_t keep = std::min(_info.packet_frames - skip, _info.frames - _pos);
+
+        // Whole packets go straight into the returned samples
+        float* dest = (keep == _info.packet_frames) ? out : _decode_buf.data();
+        const int64_t capacity = (keep == _info.packet_frames) ? keep : max_packet_frames;
+
+        if (detail::decode_packet(_decoder.get(), _packet_buf.data(), size, dest, capacity) != _info.packet_frames) {
+            throw pcm_decode_exception("opus packet has an unexpected duration");
+        }
+
+        if (dest != out && keep > 0) {
+            std::copy_n(_decode_buf.begin() + (skip * channels), keep * channels, out);
+        }
+
+        out += std::max<int64_t>(keep, 0) * channels;
+        _pos += std::max<int64_t>(keep, 0);
+    }
+
+    return samples;
+}
+
+int64_t wwise_opus_provider::rate() {
+    return opus_rate;
+}
+
+int64_t wwise_opus_provider::channels() {
+    return _info.channels;
+}
+
+uint64_t wwise_opus_provider::channel_layout() {
+    return _info.layout;
+}
+
+std::string wwise_opus_provider::name() {
+    return "Wwise Opus";
+}
+
+std::chrono::nanoseconds wwise_opus_provider::duration() {
+    return std::chrono::nanoseconds { _info.frames * 1'000'000'000 / opus_rate };
+}
+
+std::chrono::nanoseconds wwise_opus_provider::pos() {
+    return std::chrono::nanoseconds { _pos * 1'000'000'000 / opus_rate };
+}
+
+void wwise_opus_provider::seek(std::chrono::nanoseconds pos) {
+    const int64_t target = std::clamp<int64_t>(pos.count() * opus_rate / 1'000'000'000, 0, _info.frames);
+
+    // Packet index follows from the fixed packet duration
+    const int64_t decoded = target + _info.pre_skip;
+    const int64_t packet = decoded / _info.packet_frames;
+    const int64_t start = std::max<int64_t>(packet - preroll_packets, 0);
+
+    _restart(start, decoded - (start * _info.packet_frames));
+    _pos = target;
+}
+
+sample_format wwise_opus_provider::format() {
+    return sample_format::float32;
+}
+
+void wwise_opus_provider::_restart(int64_t packet, int64_t discard) {
+    opus_multistream_decoder_ctl(_decoder.get(), OPUS_RESET_STATE);
+
+    _packet = packet;
+    _discard = discard;
+    _pos = 0;
+}
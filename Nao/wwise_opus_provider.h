@@ -0,0 +1,89 @@
+#pragma once
+
+#include "pcm_provider.h"
+
+#include "wwriff.h"
+
+struct OpusMSDecoder;
+
+// Decodes Wwise Opus (fmt 0x3040), raw Opus packets whose sizes are listed in the seek chunk
+class wwise_opus_provider : public pcm_provider {
+    // Opus always decodes at 48 kHz
+    static constexpr int64_t opus_rate = 48000;
+
+    // Longest possible Opus packet duration
+    static constexpr int64_t max_packet_frames = 5760;
+
+    // Packets decoded and thrown away before a seek target, 80 ms at the usual frame size
+    static constexpr int64_t preroll_packets = 4;
+
+    static constexpr int64_t target_frames = 2048;
+
+    public:
+    using decoder_ptr = std::unique_ptr<OpusMSDecoder, void(*)(OpusMSDecoder*)>;
+
+    // Everything needed to decode, read once from the headers
+    struct stream_info {
+        int channels;
+        int64_t frames;
+
+        // Frames per packet and initial frames to skip
+        int64_t packet_frames;
+        int64_t pre_skip;
+
+        int mapping_family;
+        int streams;
+        int coupled;
+
+        // Decoder output channel to stream channel, permuted so output is in WAVE order
+        uint8_t mapping[8];
+        uint64_t layout;
+
+        std::streamoff data_offset;
+
+        // Offsets of each packet relative to data_offset, with one extra entry for the end
+        std::vector<std::streamoff> packets;
+    };
+
+    private:
+    stream_info _info;
+    decoder_ptr _decoder { nullptr, nullptr };
+
+    // Next packet to decode
+    int64_t _packet = 0;
+
+    // Frames to drop from the next decoded packets, and the position of the next returned frame
+    int64_t _discard = 0;
+    int64_t _pos = 0;
+
+    std::vector<unsigned char> _packet_buf;
+    std::vector<float> _decode_buf;
+
+    public:
+    wwise_opus_provider(const istream_ptr& stream, const wwriff::wem_info& info);
+
+    static bool supports(const wwriff::wem_info& info);
+
+    // Parse the fmt extension and the packet table
+    static bool read_info(const istream_ptr& stream, const wwriff::wem_info& info, stream_info& out);
+
+    // Decode the whole stream into interleaved floats, splitting the packets over multiple threads.
+    // Each part starts with a preroll, like a seek does, so the result matches sequential decoding after convergence
+    static bool decode_all(const istream_ptr& stream, const wwriff::wem_info& info, std::vector<float>& out, size_t threads = 0);
+
+    pcm_samples get_samples() override;
+    int64_t rate() override;
+    int64_t channels() override;
+    uint64_t channel_layout() override;
+    std::string name() override;
+
+    std::chrono::nanoseconds duration() override;
+    std::chrono::nanoseconds pos() override;
+    void seek(std::chrono::nanoseconds pos) override;
+
+    sample_format format() override;
+
+    private:
+    // Move to a packet and drop the specified number of frames after it
+    void _restart(int64_t packet, int64_t discard);
+};
@@ -1,5 +1,6 @@
 #include "wwriff.h"
 #include "byte_array_streambuf.h"
+#include "revorb_streambuf.h"
 
 #include "riff.h"
 #include "resource.h"
@@ -9,6 +10,25 @@
 
 #include <nao/logging.h>
 
+namespace detail {
+    static bool convert(wwriff_converter& conv, const ostream_ptr& out, const wwriff::conversion_options& options) {
+        if (!options.revorb) {
+            return conv.convert(out, options.policy);
+        }
+
+        // Pages are checked as they're produced, our own CRCs don't need verifying
+        revorb_streambuf buf(out, false);
+        CHECK(conv.convert(std::make_shared<binary_ostream>(std::make_shared<std::ostream>(&buf)), options.policy));
+        CHECK(buf.good());
+
+        if (buf.filter().stats().pages_rewritten > 0) {
+            nao::coutln("Fixed", buf.filter().stats().pages_rewritten, "pages with wrong granule positions");
+        }
+
+        return true;
+    }
+}
+
 namespace wwriff {
     // libvorbis
     int ilog(unsigned int v) {
@@ -67,7 +87,7 @@ namespace wwriff {
 
 
 
-    bool wwriff_to_ogg(const istream_ptr& in, const ostream_ptr& out) {
+    bool wwriff_to_ogg(const istream_ptr& in, const ostream_ptr& out, const conversion_options& options) {
         auto start = std::chrono::steady_clock::now();
 
         wwriff_converter conv(in);
@@ -75,7 +95,7 @@ namespace wwriff {
             return false;
         }
         
-        if (!conv.convert(out)) {
+        if (!detail::convert(conv, out, options)) {
             return false;
         }
 
@@ -85,6 +105,180 @@ namespace wwriff {
         return true;
     }
 
+    // Leaves the stream wherever parsing stopped
+    static bool read_info(const istream_ptr& in, wem_info& info) {
+        info = { .seek_offset = -1 };
+
+        in->seekg(0);
+
+        riff_header hdr;
+        in->read(&hdr, sizeof(hdr));
+        CHECK(in->gcount() == sizeof(hdr));
+        CHECK(std::string_view(hdr.header, 4) == "RIFF");
+
+        wave_chunk wave;
+        in->read(&wave, sizeof(wave));
+        CHECK(in->gcount() == sizeof(wave));
+        CHECK(std::string_view(wave.wave, 4) == "WAVE");
+
+        const std::streamoff riff_size = hdr.size + 8i64;
+
+        bool fmt_found = false;
+        bool data_found = false;
+        std::streamoff fmt_offset = 0;
+        std::streamsize fmt_size = 0;
+        std::streamoff vorb_offset = -1;
+        std::streamoff smpl_offset = -1;
+        std::streamoff fact_offset = -1;
+
+        std::streamoff offset = in->tellg();
+        while ((offset + 8) <= riff_size) {
+            in->seekg(offset);
+
+            riff_header chunk;
+            in->read(&chunk, sizeof(chunk));
+            if (in->gcount() != sizeof(chunk)) {
+                break;
+            }
+
+            std::string_view fcc(chunk.header, 4);
+            if (fcc == "fmt ") {
+                fmt_found = true;
+                fmt_offset = offset + 8;
+                fmt_size = chunk.size;
+            } else if (fcc == "vorb") {
+                vorb_offset = offset + 8;
+            } else if (fcc == "smpl") {
+                smpl_offset = offset + 8;
+            } else if (fcc == "fact" && chunk.size >= 4) {
+                fact_offset = offset + 8;
+            } else if (fcc == "seek") {
+                info.seek_offset = offset + 8;
+                info.seek_size = chunk.size;
+            } else if (fcc == "data") {
+                data_found = true;
+                info.data_offset = offset + 8;
+                info.data_size = chunk.size;
+            }
+
+            offset += sizeof(chunk) + chunk.size;
+        }
+
+        CHECK(fmt_found && data_found && fmt_size >= static_cast<std::streamsize>(sizeof(fmt_chunk)));
+
+        in->seekg(fmt_offset);
+
+        fmt_chunk fmt;
+        in->read(&fmt, sizeof(fmt));
+        CHECK(in->gcount() == sizeof(fmt));
+
+        CHECK(fmt.rate != 0);
+
+        info.fmt_offset = fmt_offset;
+        info.format = fmt.format;
+        info.channels = fmt.channels;
+        info.rate = fmt.rate;
+        info.bits = fmt.bits;
+        info.align = fmt.align;
+
+        if (fmt_size >= static_cast<std::streamsize>(sizeof(fmt) + sizeof(fmt_chunk_extensible))) {
+            fmt_chunk_extensible ext;
+            in->read(&ext, sizeof(ext));
+            info.channel_mask = ext.channel_mask;
+        }
+
+        switch (fmt.format) {
+            case 0xFFFF: {
+                // Vorbis, sample count is the first field of the (possibly embedded) vorb chunk
+                if (vorb_offset == -1) {
+                    CHECK(fmt_size == 66);
+                    vorb_offset = fmt_offset + 24;
+                }
+
+                in->seekg(vorb_offset);
+                in->read(info.sample_count);
+                break;
+            }
+
+            case 0xFFFE:
+                // Plain PCM
+                CHECK(fmt.align != 0);
+                info.sample_count = static_cast<uint32_t>(info.data_size / fmt.align);
+                break;
+
+            case 0x0002: {
+                // Wwise IMA ADPCM, XBOX style: a 4 byte header per channel and 2 samples per byte.
+                // The header sample is the first frame and the last nibble goes unused.
+                CHECK(fmt.channels != 0 && fmt.align > (4 * fmt.channels));
+
+                const int64_t channel_size = fmt.align / fmt.channels;
+                const int64_t tail_size = (info.data_size % fmt.align) / fmt.channels;
+
+                int64_t frames = (info.data_size / fmt.align) * (channel_size - 4) * 2;
+                if (tail_size > 4) {
+                    frames += (tail_size - 4) * 2;
+                }
+
+                info.sample_count = static_cast<uint32_t>(frames);
+
+                // The encoder's own count, if it left one, may end partway through the last block
+                if (fact_offset != -1) {
+                    in->seekg(fact_offset);
+
+                    uint32_t fact_count = 0;
+                    in->read(fact_count);
+
+                    if (fact_count > 0 && fact_count <= info.sample_count) {
+                        info.sample_count = fact_count;
+                    }
+                }
+
+                break;
+            }
+
+            case 0x3040:
+                // Opus, sample count follows the extensible fields
+                CHECK(fmt_size >= 0x1C);
+
+                in->seekg(fmt_offset + 0x18);
+                in->read(info.sample_count);
+                break;
+
+            default:
+                return false;
+        }
+
+        if (smpl_offset != -1) {
+            in->seekg(smpl_offset + 28);
+            in->read(info.loop_count);
+
+            in->seekg(smpl_offset + 44);
+            in->read(info.loop_start);
+            in->read(info.loop_end);
+
+            // Vorbis loop ends are inclusive, same adjustment as the converter. Other formats are already exclusive.
+            if (info.loop_end == 0) {
+                info.loop_end = info.sample_count;
+            } else if (info.format == 0xFFFF) {
+                ++info.loop_end;
+            }
+        }
+
+        return true;
+    }
+
+    bool probe(const istream_ptr& in, wem_info& info) {
+        // The stream is shared with whoever opened it, put it back where it was
+        const std::streamoff pos = in->tellg();
+
+        const bool result = read_info(in, info);
+
+        in->clear();
+        in->seekg(pos);
+
+        return result;
+    }
+
 }
 
 vorbis_packet::vorbis_packet(const istream_ptr& stream, std::streamoff offset, bool no_granule)
@@ -248,7 +442,9 @@ void codebook_library::rebuild(binary_istream& in, binary_ostream& out) {
 
 }
 
-wwriff_converter::wwriff_converter(const istream_ptr& in) : in { in } {
+wwriff_converter::wwriff_converter(const istream_ptr& in)
+    : _packet_ss { std::make_shared<std::stringstream>(std::ios::in | std::ios::out | std::ios::binary) }
+    , _packet_out { _packet_ss }, in { in } {
     
 }
 
@@ -263,20 +459,162 @@ bool wwriff_converter::parse() {
     return true;
 }
 
-bool wwriff_converter::convert(const ostream_ptr& out) {
+bool wwriff_converter::convert(const ostream_ptr& out, const ogg_page_policy& policy) {
     CHECK(_parsed);
 
-    ogg_stream os(out, 1);
+    ogg_stream os(out, 1, policy);
     vorbis_encoder vc;
 
+    CHECK(write_headers(os, vc));
+    CHECK(_write_audio(os, vc));
+
+    return true;
+}
+
+bool wwriff_converter::write_headers(ogg_stream& os, vorbis_encoder& vc) {
+    CHECK(_parsed);
+
     CHECK(_write_header(os, vc));
     CHECK(_write_comment(os, vc));
     CHECK(_write_setup(os, vc));
-    CHECK(_write_audio(os, vc));
 
     return true;
 }
 
+wwriff_converter::audio_state wwriff_converter::audio_start() const {
+    return {
+        .offset = _chunks[DATA].offset + _audio_offset,
+        .granulepos = 0,
+        .last_bs = 0,
+        .prev_flag = false
+    };
+}
+
+bool wwriff_converter::audio_done(const audio_state& state) const {
+    return state.offset >= (_chunks[DATA].offset + _chunks[DATA].size);
+}
+
+bool wwriff_converter::write_packet(ogg_stream& os, vorbis_encoder& vc, audio_state& state) {
+    const wwriff_chunk& data = _chunks[DATA];
+    std::streamoff& offset = state.offset;
+
+    // Temporary buffer to hold packet data
+    std::vector<uint64_t>& buf = _packet_buf;
+    binary_ostream& temp = _packet_out;
+
+    {
+        vorbis_packet packet { in, offset, true };
+
+        CHECK((offset + packet.header_size()) <= (data.offset + data.size));
+
+        offset = packet.this_offset();
+
+        in->seekg(offset);
+
+        bitwise_lock lock { temp };
+
+        if (_mod_packets) {
+            CHECK(!_mode_flag.empty());
+
+            temp.write<1>(0); // type audio
+
+            size_t remainder;
+            uintmax_t mode_number;
+            {
+                bitwise_lock lock1 { in };
+                mode_number = in->read_bits(_mode_bits);
+                temp.write_bits(mode_number, _mode_bits);
+
+                remainder = in->read_bits(8 - _mode_bits);
+            }
+
+            if (_mode_flag[mode_number]) {
+                std::streamoff next_offset = packet.next_offset();
+                in->seekg(next_offset);
+
+                bool next_flag = false;
+
+                if ((next_offset + packet.header_size()) <= (data.offset + data.size)) {
+                    vorbis_packet next_packet(in, next_offset, true);
+
+                    if (next_packet.size() > 0) {
+                        in->seekg(next_packet.this_offset());
+
+                        bitwise_lock lock1 { in };
+
+                        next_flag = _mode_flag[in->read_bits(_mode_bits)];
+                    }
+                }
+
+                temp.write<1>(state.prev_flag ? 1 : 0)
+                    .write<1>(next_flag ? 1 : 0);
+
+                in->seekg(offset + 1);
+            }
+
+            state.prev_flag = _mode_flag[mode_number];
+
+            temp.write_bits(remainder, 8 - _mode_bits);
+        } else {
+            temp.write<8>(in->read<uint8_t>());
+        }
+
+        size_t bytes = packet.size() - 1;
+        buf.resize((bytes + (sizeof(uint64_t) - 1)) / sizeof(uint64_t));
+
+        in->read(buf.data(), bytes);
+
+        for (uint64_t c : buf) {
+            if (bytes >= sizeof(uint64_t)) {
+                // At least 1 full value left
+                temp.write<sizeof(uint64_t) * CHAR_BIT>(c);
+                bytes -= sizeof(uint64_t);
+            } else {
+                temp.write_bits(c, bytes * CHAR_BIT);
+            }
+
+        }
+
+        offset = packet.next_offset();
+    }
+
+    auto packet_data = _packet_ss->str();
+
+    ogg_packet packet = os.packet(packet_data.data(), packet_data.size());
+    long bs = vc.blocksize(packet);
+
+    CHECK(bs > 0);
+    if (state.last_bs > 0) {
+        state.granulepos += (state.last_bs + bs) / 4;
+    }
+
+    state.last_bs = bs;
+    packet.granulepos = state.granulepos;
+
+    if (audio_done(state)) {
+        packet.e_o_s = 1;
+    }
+
+    os.packetin(packet);
+    os.pageout();
+
+    _packet_ss->str("");
+
+    return true;
+}
+
+uint32_t wwriff_converter::channels() const {
+    return _channels;
+}
+
+uint32_t wwriff_converter::rate() const {
+    return _rate;
+}
+
+uint32_t wwriff_converter::sample_count() const {
+    return _sample_count;
+}
+
 bool wwriff_converter::_validate_header() {
     riff_header hdr;
     in->read(&hdr, sizeof(hdr));
@@ -436,6 +774,7 @@ bool wwriff_converter::_parse_vorb() {
     in->seekg(vorb.offset);
 
     uint32_t sample_count = in->read<uint32_t>();
+    _sample_count = sample_count;
 
     switch (vorb.size) {
         case 0:
@@ -640,120 +979,11 @@ bool wwriff_converter::_write_setup(ogg_stream& os, vorbis_encoder& vc) {
     return true;
 }
 
-bool wwriff_converter::_write_audio(ogg_stream& os, vorbis_encoder& vc) const {
-    auto offset = _chunks[DATA].offset + _audio_offset;
-
-    // Temporary buffer to hold packet data
-    std::vector<uint64_t> buf;
-
-    long last_bs = 0;
-    int64_t granulepos = 0;
-
-    auto ss = std::make_shared<std::stringstream>(std::ios::in | std::ios::out | std::ios::binary);
-    binary_ostream temp(ss);
-
-    const wwriff_chunk& data = _chunks[DATA];
-
-    bool prev_flag = false;
-
-    while (offset < (data.offset + data.size)) {
-        {
-            vorbis_packet packet { in, offset, true };
-
-            CHECK((offset + packet.header_size()) <= (data.offset + data.size));
-
-            offset = packet.this_offset();
-
-            in->seekg(offset);
-
-            bitwise_lock lock { temp };
-
-            if (_mod_packets) {
-                CHECK(!_mode_flag.empty());
-
-                temp.write<1>(0); // type audio
-
-                size_t remainder;
-                uintmax_t mode_number;
-                {
-                    bitwise_lock lock1 { in };
-                    mode_number = in->read_bits(_mode_bits);
-                    temp.write_bits(mode_number, _mode_bits);
-
-                    remainder = in->read_bits(8 - _mode_bits);
-                }
-
-                if (_mode_flag[mode_number]) {
-                    std::streamoff next_offset = packet.next_offset();
-                    in->seekg(next_offset);
-
-                    bool next_flag = false;
-
-                    if ((next_offset + packet.header_size()) <= (data.offset + data.size)) {
-                        vorbis_packet next_packet(in, next_offset, true);
-
-                        if (next_packet.size() > 0) {
-                            in->seekg(next_packet.this_offset());
-
-                            bitwise_lock lock1 { in };
-
-                            next_flag = _mode_flag[in->read_bits(_mode_bits)];
-                        }
-                    }
-
-                    temp.write<1>(prev_flag ? 1 : 0)
-                        .write<1>(next_flag ? 1 : 0);
-
-                    in->seekg(offset + 1);
-                }
-
-                prev_flag = _mode_flag[mode_number];
-
-                temp.write_bits(remainder, 8 - _mode_bits);
-            } else {
-                temp.write<8>(in->read<uint8_t>());
-            }
-
-            size_t bytes = packet.size() - 1;
-            buf.resize((bytes + (sizeof(uint64_t) - 1)) / sizeof(uint64_t));
-
-            in->read(buf.data(), bytes);
-
-            for (uint64_t c : buf) {
-                if (bytes >= sizeof(uint64_t)) {
-                    // At least 1 full value left
-                    temp.write<sizeof(uint64_t) * CHAR_BIT>(c);
-                    bytes -= sizeof(uint64_t);
-                } else {
-                    temp.write_bits(c, bytes * CHAR_BIT);
-                }
-
-            }
-
-            offset = packet.next_offset();
-        }
-
-        auto packet_data = ss->str();
-
-        ogg_packet packet = os.packet(packet_data.data(), packet_data.size());
-        long bs = vc.blocksize(packet);
-
-        CHECK(bs > 0);
-        if (last_bs > 0) {
-            granulepos += (last_bs + bs) / 4;
-        }
-
-        last_bs = bs;
-        packet.granulepos = granulepos;
-
-        if (offset >= (data.offset + data.size)) {
-            packet.e_o_s = 1;
-        }
-
-        os.packetin(packet);
-        os.pageout();
+bool wwriff_converter::_write_audio(ogg_stream& os, vorbis_encoder& vc) {
+    audio_state state = audio_start();
 
-        ss->str("");
+    while (!audio_done(state)) {
+        CHECK(write_packet(os, vc, state));
     }
 
     return true;
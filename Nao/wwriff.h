@@ -1,14 +1,52 @@
 #pragma once
 
 #include "binary_stream.h"
+#include "ogg_stream.h"
 
 namespace wwriff {
     // Taken from libvorbis
     int ilog(unsigned int v);
     long book_maptype1_quantvals(long entries, long dim);
 
+    struct conversion_options {
+        ogg_page_policy policy;
+
+        // Check (and if needed fix) granule positions on the output as it's written
+        bool revorb = false;
+    };
+
     // Convert a Wwise RIFF file to a valid ogg file
-    bool wwriff_to_ogg(const istream_ptr& in, const ostream_ptr& out);
+    bool wwriff_to_ogg(const istream_ptr& in, const ostream_ptr& out, const conversion_options& options = { });
+
+    // Audio properties that can be read from the RIFF chunks alone
+    struct wem_info {
+        uint16_t format;
+        uint16_t channels;
+        uint32_t rate;
+        uint16_t bits;
+        uint16_t align;
+        uint32_t channel_mask;
+
+        uint32_t sample_count;
+
+        // Only valid if loop_count is non-zero
+        uint32_t loop_count;
+        uint32_t loop_start;
+        uint32_t loop_end;
+
+        std::streamoff data_offset;
+        std::streamsize data_size;
+
+        // Start of the fmt chunk's contents
+        std::streamoff fmt_offset;
+
+        // Packet size table of Opus files, -1 if there is none
+        std::streamoff seek_offset;
+        std::streamsize seek_size;
+    };
+
+    // Read the headers without decoding anything, the stream position is left unchanged
+    bool probe(const istream_ptr& in, wem_info& info);
 }
 
 class vorbis_packet {
@@ -51,7 +89,6 @@ class codebook_library {
     uint32_t _m_codebook_count;
 };
 
-class ogg_stream;
 class vorbis_encoder;
 
 class wwriff_converter {
@@ -93,13 +130,40 @@ class wwriff_converter {
     std::vector<bool> _mode_flag;
     size_t _mode_bits { };
 
+    uint32_t _sample_count { };
+
     bool _parsed { };
 
+    // Scratch space for rebuilding a single audio packet
+    std::shared_ptr<std::stringstream> _packet_ss;
+    binary_ostream _packet_out;
+    std::vector<uint64_t> _packet_buf;
+
     public:
+    // Position in the input audio data, enough to resume conversion at a packet boundary
+    struct audio_state {
+        std::streamoff offset;
+        int64_t granulepos;
+        long last_bs;
+        bool prev_flag;
+    };
+
     wwriff_converter(const istream_ptr& in);
 
     bool parse();
-    bool convert(const ostream_ptr& out);
+    bool convert(const ostream_ptr& out, const ogg_page_policy& policy = { });
+
+    // Incremental conversion, write the 3 header packets first,
+    // then call write_packet until audio_done returns true
+    bool write_headers(ogg_stream& os, vorbis_encoder& vc);
+
+    audio_state audio_start() const;
+    bool audio_done(const audio_state& state) const;
+    bool write_packet(ogg_stream& os, vorbis_encoder& vc, audio_state& state);
+
+    uint32_t channels() const;
+    uint32_t rate() const;
+    uint32_t sample_count() const;
 
     private:
     bool _validate_header();
@@ -114,7 +178,7 @@ class wwriff_converter {
     bool _write_header(ogg_stream& os, vorbis_encoder& vc) const;
     bool _write_comment(ogg_stream& os, vorbis_encoder& vc) const;
     bool _write_setup(ogg_stream& os, vorbis_encoder& vc);
-    bool _write_audio(ogg_stream& os, vorbis_encoder& vc) const;
+    bool _write_audio(ogg_stream& os, vorbis_encoder& vc);
 
     bool _write_floors(binary_ostream& out);
     bool _write_residue(binary_ostream& out);
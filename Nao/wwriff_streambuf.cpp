@@ -0,0 +1,256 @@
+#include "wwriff_streambuf.h"
+
+#include "ogg_stream.h"
+#include "vorbis_encoder.h"
+
+wwriff_streambuf::wwriff_streambuf(const istream_ptr& in)
+    : _conv { in }
+    , _ss { std::make_shared<std::stringstream>(std::ios::in | std::ios::out | std::ios::binary) }
+    , _out { std::make_shared<binary_ostream>(_ss) } {
+    ASSERT(_conv.parse());
+
+    _checkpoint_granules = std::max<int64_t>(_conv.rate(), pages_per_checkpoint);
+
+    _restart();
+}
+
+wwriff_streambuf::~wwriff_streambuf() = default;
+
+wwriff_converter& wwriff_streambuf::converter() {
+    return _conv;
+}
+
+const std::vector<wwriff_streambuf::checkpoint>& wwriff_streambuf::index() const {
+    return _index;
+}
+
+void wwriff_streambuf::index_until(int64_t granule) {
+    if (_size >= 0 || (!_index.empty() && _index.back().first_granule > granule)) {
+        // Already indexed
+        return;
+    }
+
+    std::streamoff pos = _cur();
+
+    while (_index.empty() || _index.back().first_granule <= granule) {
+        if (!_fill()) {
+            break;
+        }
+    }
+
+    // Return to where we were
+    seekpos(pos, std::ios::in);
+}
+
+const wwriff_streambuf::checkpoint& wwriff_streambuf::find(int64_t granule) {
+    index_until(granule);
+
+    ASSERT(!_index.empty());
+
+    auto it = std::upper_bound(_index.begin(), _index.end(), granule,
+        [](int64_t val, const checkpoint& cp) {
+            return cp.first_granule == -1 || val < cp.first_granule;
+        });
+
+    return (it == _index.begin()) ? *it : *std::prev(it);
+}
+
+wwriff_streambuf::int_type wwriff_streambuf::underflow() {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    if (!_fill()) {
+        return traits_type::eof();
+    }
+
+    return traits_type::to_int_type(*gptr());
+}
+
+wwriff_streambuf::pos_type wwriff_streambuf::seekoff(off_type offset, std::ios::seekdir dir, std::ios::openmode mode) {
+    switch (dir) {
+        case std::ios::cur: return seekpos(_cur() + offset, mode);
+        case std::ios::beg: return seekpos(offset, mode);
+        case std::ios::end:
+            // Size is unknown until the whole file has been converted
+            if (_size < 0) {
+                return pos_type(off_type(-1));
+            }
+
+            return seekpos(_size + offset, mode);
+
+        default: break;
+    }
+
+    return pos_type(off_type(-1));
+}
+
+wwriff_streambuf::pos_type wwriff_streambuf::seekpos(pos_type pos, std::ios::openmode) {
+    std::streamoff target = pos;
+    if (target < 0 || (_size >= 0 && target > _size)) {
+        return pos_type(off_type(-1));
+    }
+
+    if (target == _cur()) {
+        return pos;
+    }
+
+    auto buf_end = _buf_pos + static_cast<std::streamoff>(_buf.size());
+
+    // Inside the current buffer
+    if (target >= _buf_pos && target < buf_end) {
+        setg(_buf.data(), _buf.data() + (target - _buf_pos), _buf.data() + _buf.size());
+        return pos;
+    }
+
+    // Closest checkpoint before the target
+    auto it = std::upper_bound(_index.begin(), _index.end(), target,
+        [](std::streamoff val, const checkpoint& cp) { return val < cp.out_offset; });
+
+    if (target < _buf_pos) {
+        // Behind us, go back
+        if (it == _index.begin()) {
+            _restart();
+        } else {
+            _restore(*std::prev(it));
+        }
+    } else if (it != _index.begin() && std::prev(it)->out_offset > _produced) {
+        // Seen before, skip ahead
+        _restore(*std::prev(it));
+    }
+
+    // Convert until the target is reached
+    while (target >= (_buf_pos + static_cast<std::streamoff>(_buf.size()))) {
+        if (!_fill()) {
+            break;
+        }
+    }
+
+    buf_end = _buf_pos + static_cast<std::streamoff>(_buf.size());
+
+    if (target > buf_end) {
+        // Past the end
+        return pos_type(off_type(-1));
+    }
+
+    setg(_buf.data(), _buf.data() + (target - _buf_pos), _buf.data() + _buf.size());
+
+    return pos;
+}
+
+std::streamoff wwriff_streambuf::_cur() const {
+    return _buf_pos + std::distance(eback(), gptr());
+}
+
+std::streamoff wwriff_streambuf::_tell() const {
+    return _produced + static_cast<std::streamoff>(_ss->tellp());
+}
+
+void wwriff_streambuf::_restart() {
+    // Destroying the ogg_stream flushes it, so discard the output afterwards
+    _os.reset();
+    _ss->str("");
+
+    _os = std::make_unique<ogg_stream>(_out, 1,
+        ogg_page_policy { .max_granules = _checkpoint_granules / pages_per_checkpoint });
+    _vc = std::make_unique<vorbis_encoder>();
+
+    _state = { };
+    _headers_written = false;
+    _done = false;
+    _granule_pending = false;
+    _next_checkpoint = 0;
+
+    _buf.clear();
+    _buf_pos = 0;
+    _produced = 0;
+
+    setg(nullptr, nullptr, nullptr);
+}
+
+void wwriff_streambuf::_restore(const checkpoint& cp) {
+    _os->restore(cp.packetno, cp.pageno);
+    _ss->str("");
+
+    _state = cp.state;
+    _headers_written = true;
+    _done = false;
+    _granule_pending = false;
+    _next_checkpoint = cp.state.granulepos + _checkpoint_granules;
+
+    _buf.clear();
+    _buf_pos = cp.out_offset;
+    _produced = cp.out_offset;
+
+    setg(nullptr, nullptr, nullptr);
+}
+
+bool wwriff_streambuf::_fill() {
+    _buf_pos = _produced;
+
+    while (_ss->tellp() < chunk_size && _step()) { }
+
+    std::string data = _ss->str();
+    _ss->str("");
+
+    _buf.assign(data.begin(), data.end());
+    _produced += static_cast<std::streamoff>(_buf.size());
+
+    setg(_buf.data(), _buf.data(), _buf.data() + _buf.size());
+
+    return !_buf.empty();
+}
+
+bool wwriff_streambuf::_step() {
+    if (_done) {
+        return false;
+    }
+
+    if (!_headers_written) {
+        ASSERT(_conv.write_headers(*_os, *_vc));
+
+        _headers_written = true;
+        _state = _conv.audio_start();
+    }
+
+    if (_conv.audio_done(_state)) {
+        _os->flush();
+
+        _done = true;
+        _size = _tell();
+
+        return false;
+    }
+
+    // Start a page for a checkpoint every interval, otherwise the page policy decides.
+    // Only based on the position, so converting again after a restore gives the same pages.
+    if (_state.granulepos >= _next_checkpoint) {
+        _os->flush();
+        _next_checkpoint = _state.granulepos + _checkpoint_granules;
+
+        const std::streamoff offset = _tell();
+
+        if (_index.empty() || offset > _index.back().out_offset) {
+            _index.push_back({
+                .out_offset = offset,
+                .packetno = _os->packetno(),
+                .pageno = _os->pageno(),
+                .first_granule = -1,
+                .state = _state
+            });
+
+            _granule_pending = true;
+        }
+    }
+
+    bool first_after_checkpoint = _granule_pending;
+
+    ASSERT(_conv.write_packet(*_os, *_vc, _state));
+
+    if (first_after_checkpoint) {
+        _index.back().first_granule = _state.granulepos;
+        _granule_pending = false;
+    }
+
+    return true;
+}
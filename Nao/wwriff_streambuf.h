@@ -0,0 +1,89 @@
+#pragma once
+
+#include "wwriff.h"
+
+class ogg_stream;
+class vorbis_encoder;
+
+// Converts a Wwise RIFF file to Ogg on demand, only as much as is being read
+class wwriff_streambuf : public std::streambuf {
+    public:
+    // Output position at which the conversion can be resumed
+    struct checkpoint {
+        std::streamoff out_offset;
+        int64_t packetno;
+        int64_t pageno;
+
+        // Granule position of the first packet after this point
+        int64_t first_granule;
+
+        wwriff_converter::audio_state state;
+    };
+
+    private:
+    // Minimum number of bytes to convert per underflow
+    static constexpr std::streamsize chunk_size = 4096;
+
+    // Pages are capped to a fraction of the checkpoint interval
+    static constexpr int64_t pages_per_checkpoint = 4;
+
+    wwriff_converter _conv;
+
+    std::shared_ptr<std::stringstream> _ss;
+    ostream_ptr _out;
+    std::unique_ptr<ogg_stream> _os;
+    std::unique_ptr<vorbis_encoder> _vc;
+
+    wwriff_converter::audio_state _state { };
+    bool _headers_written = false;
+    bool _done = false;
+
+    bool _granule_pending = false;
+
+    // Granules between checkpoints (a second of audio, what a seek may decode and discard), and where the next one is due
+    int64_t _checkpoint_granules;
+    int64_t _next_checkpoint = 0;
+
+    // Current get area, and it's position in the output
+    std::vector<char> _buf;
+    std::streamoff _buf_pos = 0;
+
+    // Bytes moved out of _ss so far
+    std::streamoff _produced = 0;
+
+    // Total size, only known after a full conversion
+    std::streamsize _size = -1;
+
+    std::vector<checkpoint> _index;
+
+    public:
+    explicit wwriff_streambuf(const istream_ptr& in);
+    ~wwriff_streambuf() override;
+
+    wwriff_converter& converter();
+
+    // Checkpoints found so far, about one per second of audio, ordered by output offset
+    const std::vector<checkpoint>& index() const;
+
+    // Convert until a checkpoint past the specified granule is found, or the stream ends
+    void index_until(int64_t granule);
+
+    // Last checkpoint from which decoding resumes at or before the specified granule
+    const checkpoint& find(int64_t granule);
+
+    protected:
+    int_type underflow() override;
+    pos_type seekoff(off_type offset, std::ios::seekdir dir, std::ios::openmode mode) override;
+    pos_type seekpos(pos_type pos, std::ios::openmode mode) override;
+
+    private:
+    std::streamoff _cur() const;
+    std::streamoff _tell() const;
+
+    void _restart();
+    void _restore(const checkpoint& cp);
+
+    // Convert the next chunk into the get area, false on EOF
+    bool _fill();
+    bool _step();
+};
@@ -0,0 +1,246 @@
+#include "bench.h"
+#include "test_provider.h"
+
+#include "audio_player.h"
+
+#include <thread>
+#include <new>
+#include <cstdlib>
+#include <atomic>
+
+// Allocations made by threads that set count_allocations, for checking the audio callback never allocates
+namespace detail {
+    static thread_local bool count_allocations = false;
+    static std::atomic<size_t> allocations = 0;
+}
+
+void* operator new(size_t size) {
+    if (detail::count_allocations) {
+        ++detail::allocations;
+    }
+
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace detail {
+    // Keeps the player's callback so the bench thread can play the audio device
+    class manual_sink : public audio_sink {
+        public:
+        callback cb;
+        std::atomic<bool> playing = false;
+
+        explicit manual_sink(callback cb) : cb { std::move(cb) } { }
+
+        void pause() override {
+            playing = false;
+        }
+
+        void play() override {
+            playing = true;
+        }
+    };
+
+    // Fill a device buffer the way sdl::audio::device does, returns the bytes the player provided
+    static size_t fill(manual_sink& sink, char* buffer, size_t len) {
+        size_t filled = 0;
+
+        while (filled < len) {
+            const size_t written = sink.cb(buffer + filled, len - filled);
+            if (written == 0) {
+                break;
+            }
+
+            filled += written;
+        }
+
+        std::fill_n(buffer + filled, len - filled, '\0');
+        return filled;
+    }
+
+    // Takes a while to seek, like a decoder resuming far into a file
+    class slow_seek_provider : public sine_provider {
+        public:
+        std::atomic<bool> seeking = false;
+
+        using sine_provider::sine_provider;
+
+        void seek(std::chrono::nanoseconds pos) override {
+            seeking = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+            sine_provider::seek(pos);
+            seeking = false;
+        }
+    };
+}
+
+BENCH_SUITE(audio_callback_fill) {
+    // Usual device buffer sizes at 48 kHz, called in real time for one second each
+    for (size_t buffer_frames : { 256u, 512u, 1024u, 4096u }) {
+        detail::manual_sink* sink = nullptr;
+
+        audio_player player { std::make_shared<sine_provider>(48000, 2, 48000 * 10),
+            [&](const audio_sink::spec&, audio_sink::callback cb) {
+                auto result = std::make_unique<detail::manual_sink>(std::move(cb));
+                sink = result.get();
+                return result;
+            } };
+
+        player.play();
+
+        // Let the decoder fill its ring once, like the device startup would
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        std::vector<char> buffer(buffer_frames * 4);
+        const auto period = std::chrono::nanoseconds { static_cast<int64_t>(buffer_frames) * 1'000'000'000 / 48000 };
+        const size_t calls = 48000 / buffer_frames;
+
+        std::vector<double> times;
+        times.reserve(calls);
+
+        size_t short_fills = 0;
+        size_t allocations = 0;
+        auto next = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < calls; ++i) {
+            std::this_thread::sleep_until(next);
+            next += period;
+
+            detail::allocations = 0;
+            detail::count_allocations = true;
+
+            const auto start = std::chrono::steady_clock::now();
+            const size_t filled = detail::fill(*sink, buffer.data(), buffer.size());
+            const auto end = std::chrono::steady_clock::now();
+
+            detail::count_allocations = false;
+            allocations += detail::allocations;
+
+            times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+
+            if (filled < buffer.size()) {
+                ++short_fills;
+            }
+        }
+
+        std::ranges::sort(times);
+
+        nao::coutln("  ", buffer_frames, "frames: median", times[times.size() / 2], "us, 99th",
+            times[(times.size() * 99) / 100], "us, max", times.back(), "us,", short_fills, "short fills");
+
+        BENCH_EXPECT(allocations == 0);
+        BENCH_EXPECT(short_fills == 0);
+    }
+
+    return true;
+}
+
+BENCH_SUITE(null_sink_pull) {
+    // Ten seconds pulled as fast as the player decodes, timing every callback on the sink thread
+    static constexpr int64_t frames = 48000 * 10;
+
+    std::vector<double> times;
+    times.reserve(4096);
+
+    std::atomic<size_t> empty = 0;
+    null_sink* sink = nullptr;
+
+    audio_player player { std::make_shared<sine_provider>(44100, 6, frames * 44100 / 48000, 0x3f),
+        [&](const audio_sink::spec& spec, audio_sink::callback cb) {
+            auto result = std::make_unique<null_sink>(spec, [&, cb = std::move(cb)](char* buffer, size_t len) {
+                detail::count_allocations = true;
+
+                const auto start = std::chrono::steady_clock::now();
+                const size_t written = cb(buffer, len);
+                const auto end = std::chrono::steady_clock::now();
+
+                if (written == 0) {
+                    ++empty;
+                } else if (times.size() < times.capacity()) {
+                    times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+                }
+
+                return written;
+            });
+
+            sink = result.get();
+            return result;
+        } };
+
+    detail::allocations = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    player.play();
+
+    while (!player.eof() && !player.failed()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    player.pause();
+
+    BENCH_EXPECT(!player.failed());
+    BENCH_EXPECT(!times.empty());
+
+    std::ranges::sort(times);
+
+    const double played = static_cast<double>(sink->pulled()) / 4. / 48000.;
+    nao::coutln("  5.1 at 44.1 kHz:", played / seconds, "x real time,", sink->callbacks(), "callbacks,", empty.load(), "empty,",
+        "median", times[times.size() / 2], "us, 99th", times[(times.size() * 99) / 100], "us, max", times.back(), "us,",
+        detail::allocations.load(), "allocations");
+
+    BENCH_EXPECT(detail::allocations == 0);
+
+    return true;
+}
+
+BENCH_SUITE(audio_player_seek) {
+    detail::manual_sink* sink = nullptr;
+    auto provider = std::make_shared<detail::slow_seek_provider>(48000, 2, 48000 * 10);
+
+    audio_player player { provider, [&](const audio_sink::spec&, audio_sink::callback cb) {
+        auto result = std::make_unique<detail::manual_sink>(std::move(cb));
+        sink = result.get();
+        return result;
+    } };
+
+    player.play();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<char> buffer(1024 * 4);
+    BENCH_EXPECT(detail::fill(*sink, buffer.data(), buffer.size()) == buffer.size());
+
+    // While the provider seeks, the ring still holds the old position's audio, none of it may play or count
+    const auto target = std::chrono::seconds { 5 };
+    player.seek(target);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    size_t stale = 0;
+    while (provider->seeking) {
+        stale += detail::fill(*sink, buffer.data(), buffer.size());
+        BENCH_EXPECT(player.pos() == target);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    BENCH_EXPECT(stale == 0);
+
+    // Then the position counts from the target
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    BENCH_EXPECT(detail::fill(*sink, buffer.data(), buffer.size()) == buffer.size());
+    BENCH_EXPECT(player.pos() == target + std::chrono::nanoseconds { 1024ll * 1'000'000'000 / 48000 });
+
+    return true;
+}
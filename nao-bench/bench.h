@@ -0,0 +1,51 @@
+#pragma once
+
+#include <functional>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+#include <nao/logging.h>
+
+// A named check or benchmark, returns false if anything it compared didn't match
+struct bench_suite {
+    std::string_view name;
+    std::function<bool()> run;
+};
+
+std::vector<bench_suite>& bench_suites();
+
+struct bench_registration {
+    bench_registration(std::string_view name, std::function<bool()> run);
+};
+
+// Defines a suite and registers it before main runs
+#define BENCH_SUITE(name) \
+    static bool name(); \
+    static bench_registration name##_registration { #name, name }; \
+    static bool name()
+
+// Fails the enclosing suite with the condition's text
+#define BENCH_EXPECT(cond) \
+    if (!(cond)) { \
+        nao::coutln("  failed:", #cond, "at", __FILE__, __LINE__); \
+        return false; \
+    }
+
+// Fastest of a few runs, in seconds
+template <typename Func>
+double bench_time(Func&& func, int runs = 5) {
+    double best = std::numeric_limits<double>::max();
+
+    for (int i = 0; i < runs; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        func();
+        const auto end = std::chrono::steady_clock::now();
+
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+
+    return best;
+}
@@ -0,0 +1,149 @@
+#include "bench.h"
+
+#include "downmix.h"
+#include "ffmpeg.h"
+
+#include <random>
+#include <bit>
+#include <cmath>
+
+namespace detail {
+    // 5.1 with back or side surrounds, and 7.1
+    static constexpr uint64_t surround_layouts[] { 0x3f, 0x60f, 0x63f };
+
+    static std::vector<float> random_frames(size_t channels, size_t frames, uint32_t seed) {
+        std::mt19937 rng { seed };
+        std::uniform_real_distribution<float> dist { -1.f, 1.f };
+
+        std::vector<float> result(channels * frames);
+        std::ranges::generate(result, [&] { return dist(rng); });
+        return result;
+    }
+
+    // Interleaved float at the same rate, so swresample only rematrixes
+    static std::vector<float> swresample_stereo(uint64_t layout, size_t channels, std::vector<float> in) {
+        const auto frames = static_cast<int64_t>(in.size() / channels);
+
+        ffmpeg::swresample::context swr {
+            { static_cast<int64_t>(layout), AV_SAMPLE_FMT_FLT, 48000 },
+            { AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_FLT, 48000 }
+        };
+
+        std::vector<float> out(static_cast<size_t>(frames) * 2);
+
+        char* in_planes[] { reinterpret_cast<char*>(in.data()) };
+        char* out_planes[] { reinterpret_cast<char*>(out.data()) };
+
+        out.resize(static_cast<size_t>(swr.convert(in_planes, frames, out_planes, frames)) * 2);
+        return out;
+    }
+
+    // What a plain matrix multiply does, to compare the kernel against
+    static void downmix_loop(const downmix& mix, const float* in, size_t frames, float* out) {
+        for (size_t f = 0; f < frames; ++f) {
+            for (size_t o = 0; o < mix.out_channels(); ++o) {
+                float sum = 0.f;
+                for (size_t i = 0; i < mix.in_channels(); ++i) {
+                    sum += in[i] * mix.coefficient(o, i);
+                }
+
+                out[o] = sum;
+            }
+
+            in += mix.in_channels();
+            out += mix.out_channels();
+        }
+    }
+}
+
+BENCH_SUITE(downmix_matches_swresample) {
+    for (uint64_t layout : detail::surround_layouts) {
+        const auto channels = static_cast<size_t>(std::popcount(layout));
+
+        // swresample leaves float output unnormalized by default
+        const downmix mix = downmix::stereo(layout, channels, { .normalize = false });
+
+        // One impulse per channel gives swresample's matrix, column by column
+        std::vector<float> impulses(channels * channels, 0.f);
+        for (size_t c = 0; c < channels; ++c) {
+            impulses[(c * channels) + c] = 1.f;
+        }
+
+        const std::vector<float> columns = detail::swresample_stereo(layout, channels, impulses);
+        BENCH_EXPECT(columns.size() == channels * 2);
+
+        for (size_t c = 0; c < channels; ++c) {
+            for (size_t o = 0; o < 2; ++o) {
+                BENCH_EXPECT(std::abs(columns[(c * 2) + o] - mix.coefficient(o, c)) < 1e-6f);
+            }
+        }
+
+        // And the same output for arbitrary samples
+        const size_t frames = 1021;
+        const std::vector<float> in = detail::random_frames(channels, frames, static_cast<uint32_t>(layout));
+        const std::vector<float> expected = detail::swresample_stereo(layout, channels, in);
+        BENCH_EXPECT(expected.size() == frames * 2);
+
+        std::vector<float> actual(frames * 2);
+        mix.apply(in.data(), frames, actual.data());
+
+        for (size_t i = 0; i < actual.size(); ++i) {
+            BENCH_EXPECT(std::abs(actual[i] - expected[i]) < 1e-5f);
+        }
+
+        // Normalizing scales the whole matrix down by its loudest output
+        const downmix normalized = downmix::stereo(layout, channels);
+
+        float max = 0.f;
+        for (size_t o = 0; o < 2; ++o) {
+            float sum = 0.f;
+            for (size_t c = 0; c < channels; ++c) {
+                sum += std::abs(mix.coefficient(o, c));
+            }
+
+            max = std::max(max, sum);
+        }
+
+        for (size_t c = 0; c < channels; ++c) {
+            for (size_t o = 0; o < 2; ++o) {
+                BENCH_EXPECT(std::abs(normalized.coefficient(o, c) - (mix.coefficient(o, c) / max)) < 1e-6f);
+            }
+        }
+
+        nao::coutln("  layout", layout, "matches");
+    }
+
+    return true;
+}
+
+BENCH_SUITE(downmix_throughput) {
+    // One second blocks of 48 kHz audio, repeated for a stable figure
+    static constexpr size_t frames = 48000;
+    static constexpr int repeats = 20;
+
+    for (uint64_t layout : { 0x60full, 0x63full }) {
+        const auto channels = static_cast<size_t>(std::popcount(layout));
+        const downmix mix = downmix::stereo(layout, channels);
+
+        const std::vector<float> in = detail::random_frames(channels, frames, 1);
+        std::vector<float> out(frames * 2);
+
+        const double loop = bench_time([&] {
+            for (int i = 0; i < repeats; ++i) {
+                detail::downmix_loop(mix, in.data(), frames, out.data());
+            }
+        });
+
+        const double kernel = bench_time([&] {
+            for (int i = 0; i < repeats; ++i) {
+                mix.apply(in.data(), frames, out.data());
+            }
+        });
+
+        const double seconds = static_cast<double>(repeats);
+        nao::coutln("  ", channels, "channels: loop", seconds / loop, "x real time, kernel", seconds / kernel,
+            "x real time,", loop / kernel, "x");
+    }
+
+    return true;
+}
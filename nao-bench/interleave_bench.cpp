@@ -0,0 +1,97 @@
+#include "bench.h"
+
+#include "pcm_interleave.h"
+
+#include <random>
+
+namespace detail {
+    // What ffmpeg_pcm_provider did before the kernels, one copy_n per sample
+    static void interleave_loop(const char* const* planes, size_t sample_size, size_t channels, size_t frames, char* out) {
+        for (size_t i = 0; i < frames; ++i) {
+            for (size_t c = 0; c < channels; ++c) {
+                std::copy_n(planes[c] + (sample_size * i), sample_size, out);
+                out += sample_size;
+            }
+        }
+    }
+
+    struct planar_data {
+        std::vector<std::vector<char>> storage;
+        std::vector<const char*> planes;
+        std::vector<char*> writable;
+
+        planar_data(size_t channels, size_t bytes, uint32_t seed) {
+            std::mt19937 rng { seed };
+
+            for (size_t c = 0; c < channels; ++c) {
+                auto& plane = storage.emplace_back(bytes);
+                std::ranges::generate(plane, [&] { return static_cast<char>(rng()); });
+            }
+
+            for (auto& plane : storage) {
+                planes.push_back(plane.data());
+                writable.push_back(plane.data());
+            }
+        }
+    };
+}
+
+BENCH_SUITE(interleave_matches_loop) {
+    for (sample_format fmt : { sample_format::uint8p, sample_format::int16p, sample_format::float32p, sample_format::float64p }) {
+        const size_t sample_size = samples::sample_size(fmt);
+
+        for (size_t channels : { 1u, 2u, 3u, 6u, 8u }) {
+            // Not a multiple of any vector or block size
+            const size_t frames = 1021;
+
+            detail::planar_data in { channels, frames * sample_size, static_cast<uint32_t>(channels) };
+
+            std::vector<char> expected(frames * channels * sample_size);
+            std::vector<char> actual(expected.size());
+
+            detail::interleave_loop(in.planes.data(), sample_size, channels, frames, expected.data());
+            samples::interleave(in.planes.data(), fmt, channels, frames, actual.data());
+            BENCH_EXPECT(expected == actual);
+
+            // And back again
+            detail::planar_data out { channels, frames * sample_size, 0 };
+            samples::deinterleave(actual.data(), fmt, channels, frames, out.writable.data());
+            BENCH_EXPECT(out.storage == in.storage);
+        }
+    }
+
+    return true;
+}
+
+BENCH_SUITE(interleave_throughput) {
+    // One second blocks of 48 kHz audio, repeated for a stable figure
+    static constexpr size_t frames = 48000;
+    static constexpr int repeats = 20;
+
+    for (sample_format fmt : { sample_format::int16p, sample_format::float32p }) {
+        const size_t sample_size = samples::sample_size(fmt);
+
+        for (size_t channels : { 2u, 6u, 8u }) {
+            detail::planar_data in { channels, frames * sample_size, 1 };
+            std::vector<char> out(frames * channels * sample_size);
+
+            const double loop = bench_time([&] {
+                for (int i = 0; i < repeats; ++i) {
+                    detail::interleave_loop(in.planes.data(), sample_size, channels, frames, out.data());
+                }
+            });
+
+            const double kernel = bench_time([&] {
+                for (int i = 0; i < repeats; ++i) {
+                    samples::interleave(in.planes.data(), fmt, channels, frames, out.data());
+                }
+            });
+
+            const double bytes = static_cast<double>(out.size()) * repeats;
+            nao::coutln("  ", samples::format_name(fmt), channels, "channels: loop", bytes / loop / 1e9, "GB/s, kernel",
+                bytes / kernel / 1e9, "GB/s,", loop / kernel, "x");
+        }
+    }
+
+    return true;
+}
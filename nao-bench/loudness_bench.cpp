@@ -0,0 +1,67 @@
+#include "bench.h"
+#include "test_provider.h"
+
+#include "loudness.h"
+#include "thread_pool.h"
+
+#include <latch>
+
+namespace detail {
+    // Measure every item on a pool the way loudness_scan does, one item per task
+    static std::vector<loudness_meter::result> measure_all(size_t threads, size_t items, int64_t frames) {
+        std::vector<loudness_meter::result> results(items);
+
+        thread_pool pool { threads };
+        std::latch done { static_cast<std::ptrdiff_t>(items) };
+
+        for (size_t i = 0; i < items; ++i) {
+            pool.push([&, i] {
+                results[i] = *loudness_meter::measure(std::make_shared<sine_provider>(48000, 6, frames, 0x60f));
+                done.count_down();
+            });
+        }
+
+        done.wait();
+        return results;
+    }
+}
+
+BENCH_SUITE(loudness_scaling) {
+    // Ten seconds of 5.1 per item, a few items per core so the last ones don't leave cores idle
+    static constexpr int64_t frames = 48000 * 10;
+
+    const size_t cores = std::max<size_t>(thread_pool::pool_size(), 1);
+    const size_t items = std::max<size_t>(cores * 4, 8);
+
+    std::vector<size_t> counts;
+    for (size_t threads = 1; threads < cores; threads *= 2) {
+        counts.push_back(threads);
+    }
+
+    counts.push_back(cores);
+
+    const std::vector<loudness_meter::result> expected = detail::measure_all(1, 1, frames);
+    double single = 0.;
+
+    for (size_t threads : counts) {
+        std::vector<loudness_meter::result> results;
+        const double seconds = bench_time([&] { results = detail::measure_all(threads, items, frames); }, 3);
+
+        // Items are independent, the thread count never changes a result
+        for (const loudness_meter::result& result : results) {
+            BENCH_EXPECT(result.frames == expected[0].frames);
+            BENCH_EXPECT(result.integrated == expected[0].integrated);
+            BENCH_EXPECT(result.true_peak == expected[0].true_peak);
+        }
+
+        if (threads == 1) {
+            single = seconds;
+        }
+
+        const double speedup = single / seconds;
+        nao::coutln("  ", threads, "threads:", static_cast<double>(items) * 10. / seconds, "x real time,", speedup,
+            "x the single thread,", speedup * 100. / static_cast<double>(threads), "% efficiency");
+    }
+
+    return true;
+}
@@ -0,0 +1,42 @@
+#include "bench.h"
+
+#include <string>
+
+std::vector<bench_suite>& bench_suites() {
+    static std::vector<bench_suite> suites;
+    return suites;
+}
+
+bench_registration::bench_registration(std::string_view name, std::function<bool()> run) {
+    bench_suites().push_back({ name, std::move(run) });
+}
+
+// nao-bench [suite...], runs every suite without arguments
+int main(int argc, char** argv) {
+    std::vector<std::string_view> names(argv + 1, argv + argc);
+
+    int failed = 0;
+    for (const bench_suite& suite : bench_suites()) {
+        if (!names.empty() && std::ranges::find(names, suite.name) == names.end()) {
+            continue;
+        }
+
+        nao::coutln(suite.name);
+
+        bool passed;
+        try {
+            passed = suite.run();
+        } catch (const std::exception& e) {
+            nao::coutln("  threw:", e.what());
+            passed = false;
+        }
+
+        if (!passed) {
+            ++failed;
+        }
+
+        nao::coutln(passed ? "  ok" : "  FAILED");
+    }
+
+    return (failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,293 @@
+#include "bench.h"
+
+#include "ogg_stream.h"
+
+#include <random>
+#include <sstream>
+
+// Pages written by ogg_stream must match libogg's ogg_stream_pageout/ogg_stream_flush byte for byte
+namespace detail {
+    struct packet_spec {
+        size_t size;
+
+        // Pageout after this packet, otherwise it queues up with the next ones
+        bool pageout;
+    };
+
+    static std::string with_libogg(const std::vector<packet_spec>& packets, const std::vector<std::vector<unsigned char>>& data) {
+        std::string result;
+
+        auto append = [&](const ogg_page& page) {
+            result.append(reinterpret_cast<const char*>(page.header), static_cast<size_t>(page.header_len));
+            result.append(reinterpret_cast<const char*>(page.body), static_cast<size_t>(page.body_len));
+        };
+
+        ogg_stream_state os;
+        ogg_stream_init(&os, 1234);
+
+        ogg_page page;
+        for (size_t i = 0; i < packets.size(); ++i) {
+            ogg_packet packet {
+                .packet = const_cast<unsigned char*>(data[i].data()),
+                .bytes = static_cast<long>(data[i].size()),
+                .b_o_s = (i == 0) ? 1 : 0,
+                .e_o_s = (i + 1 == packets.size()) ? 1 : 0,
+                .granulepos = static_cast<ogg_int64_t>(i * 1024),
+                .packetno = static_cast<ogg_int64_t>(i)
+            };
+
+            ogg_stream_packetin(&os, &packet);
+
+            if (packets[i].pageout) {
+                while (ogg_stream_pageout(&os, &page)) {
+                    append(page);
+                }
+            }
+        }
+
+        while (ogg_stream_flush(&os, &page)) {
+            append(page);
+        }
+
+        ogg_stream_clear(&os);
+        return result;
+    }
+
+    static std::string with_ogg_stream(const std::vector<packet_spec>& packets, const std::vector<std::vector<unsigned char>>& data) {
+        auto result = std::make_shared<std::ostringstream>();
+
+        {
+            ogg_stream os { std::make_shared<binary_ostream>(result), 1234 };
+
+            // Packet memory only has to last until the next pageout or flush, scribble over it after
+            std::vector<std::vector<unsigned char>> pending;
+            auto release = [&] {
+                for (std::vector<unsigned char>& bytes : pending) {
+                    std::ranges::fill(bytes, 0xA5);
+                }
+
+                pending.clear();
+            };
+
+            for (size_t i = 0; i < packets.size(); ++i) {
+                std::vector<unsigned char>& bytes = pending.emplace_back(data[i]);
+
+                ogg_packet packet = os.packet(reinterpret_cast<char*>(bytes.data()),
+                    static_cast<int64_t>(bytes.size()), i + 1 == packets.size());
+                packet.granulepos = static_cast<int64_t>(i * 1024);
+
+                os.packetin(packet);
+
+                if (packets[i].pageout) {
+                    os.pageout();
+                    release();
+                }
+            }
+
+            os.flush();
+            release();
+        }
+
+        return result->str();
+    }
+
+    static bool compare(const std::vector<packet_spec>& packets, uint32_t seed) {
+        std::mt19937 rng { seed };
+
+        std::vector<std::vector<unsigned char>> data;
+        for (const packet_spec& spec : packets) {
+            auto& bytes = data.emplace_back(spec.size);
+            std::ranges::generate(bytes, [&] { return static_cast<unsigned char>(rng()); });
+        }
+
+        const std::string expected = with_libogg(packets, data);
+        const std::string actual = with_ogg_stream(packets, data);
+
+        if (expected != actual) {
+            const auto mismatch = std::ranges::mismatch(expected, actual);
+            nao::coutln("  ", packets.size(), "packets differ at byte", mismatch.in1 - expected.begin(),
+                "of", expected.size(), "/", actual.size());
+            return false;
+        }
+
+        return true;
+    }
+}
+
+BENCH_SUITE(ogg_stream_matches_libogg) {
+    using detail::packet_spec;
+
+    // Sizes around the lacing boundaries, and a packet spanning several pages
+    BENCH_EXPECT(detail::compare({ { 30, true }, { 0, true }, { 254, true }, { 255, true }, { 256, true }, { 510, true },
+        { 70000, true }, { 12, true } }, 1));
+
+    // Headers queued before the first pageout, only the first one goes on the first page and the rest wait for the fill
+    BENCH_EXPECT(detail::compare({ { 30, false }, { 120, false }, { 3000, true }, { 200, true }, { 200, true }, { 200, true } }, 2));
+
+    // Many small packets, pages end on the 4096 byte fill and the 255 segment limit
+    {
+        std::vector<packet_spec> packets { { 30, true } };
+        std::mt19937 rng { 3 };
+
+        for (int i = 0; i < 5000; ++i) {
+            packets.push_back({ rng() % 400, (rng() % 4) != 0 });
+        }
+
+        BENCH_EXPECT(detail::compare(packets, 4));
+    }
+
+    // Only a single pageout at the end
+    {
+        std::vector<packet_spec> packets;
+        for (int i = 0; i < 300; ++i) {
+            packets.push_back({ static_cast<size_t>(i * 7) % 600, i == 299 });
+        }
+
+        BENCH_EXPECT(detail::compare(packets, 5));
+    }
+
+    return true;
+}
+
+namespace detail {
+    struct page_limits {
+        int max_packets = 0;
+        int64_t max_granules = 0;
+    };
+
+    // Read back every page, checking its CRC, that the packets come out intact,
+    // and that no page finishes more packets or spans more granules than the policy allows
+    static bool check_pages(const std::string& stream, const std::vector<std::vector<unsigned char>>& data,
+        const std::vector<int64_t>& granules, const page_limits& limits) {
+        const auto* bytes = reinterpret_cast<const unsigned char*>(stream.data());
+
+        size_t pos = 0;
+        size_t packet = 0;
+        std::vector<unsigned char> body;
+
+        while (pos < stream.size()) {
+            BENCH_EXPECT(pos + 27 <= stream.size() && std::equal(bytes + pos, bytes + pos + 4, "OggS"));
+
+            const size_t segments = bytes[pos + 26];
+            const unsigned char* lacing = bytes + pos + 27;
+
+            size_t body_size = 0;
+            for (size_t i = 0; i < segments; ++i) {
+                body_size += lacing[i];
+            }
+
+            const size_t page_size = 27 + segments + body_size;
+            BENCH_EXPECT(pos + page_size <= stream.size());
+
+            std::vector<unsigned char> page(bytes + pos, bytes + pos + page_size);
+            std::fill_n(page.begin() + 22, 4, 0);
+
+            uint32_t stored = 0;
+            for (size_t i = 0; i < 4; ++i) {
+                stored |= static_cast<uint32_t>(bytes[pos + 22 + i]) << (8 * i);
+            }
+
+            BENCH_EXPECT(ogg_stream::crc(0, page.data(), page.size()) == stored);
+
+            int finished = 0;
+            int64_t first = -1;
+            int64_t last = -1;
+
+            const unsigned char* in = lacing + segments;
+            for (size_t i = 0; i < segments; ++i) {
+                body.insert(body.end(), in, in + lacing[i]);
+                in += lacing[i];
+
+                if (lacing[i] < 255) {
+                    BENCH_EXPECT(packet < data.size() && body == data[packet]);
+
+                    last = granules[packet];
+                    if (finished++ == 0) {
+                        first = last;
+                    }
+
+                    body.clear();
+                    ++packet;
+                }
+            }
+
+            if (limits.max_packets > 0) {
+                BENCH_EXPECT(finished <= limits.max_packets);
+            }
+
+            if (limits.max_granules > 0 && finished > 0) {
+                BENCH_EXPECT(last - first <= limits.max_granules);
+            }
+
+            pos += page_size;
+        }
+
+        BENCH_EXPECT(packet == data.size());
+
+        return true;
+    }
+}
+
+BENCH_SUITE(ogg_stream_page_policy) {
+    struct policy_case {
+        ogg_page_policy policy;
+
+        // Pageout after every packet, otherwise only every few
+        bool every_packet;
+    };
+
+    const policy_case cases[] {
+        { { .max_packets = 4 }, true },
+        { { .max_packets = 7 }, false },
+        { { .max_granules = 4096 }, true },
+        { { .max_granules = 10000 }, false },
+        { { .fill_bytes = 1024, .max_packets = 10, .max_granules = 8192 }, true },
+        { { .fill_bytes = 16384, .max_packets = 50 }, true }
+    };
+
+    uint32_t seed = 10;
+
+    for (const policy_case& test : cases) {
+        std::mt19937 rng { seed++ };
+
+        // Vorbis like, long and short blocks and the odd packet spanning pages
+        std::vector<std::vector<unsigned char>> data;
+        std::vector<int64_t> granules;
+        int64_t granule = 0;
+
+        for (int i = 0; i < 3000; ++i) {
+            const size_t size = ((rng() % 50) == 0) ? 5000 + (rng() % 3000) : rng() % 600;
+
+            auto& bytes = data.emplace_back(size);
+            std::ranges::generate(bytes, [&] { return static_cast<unsigned char>(rng()); });
+
+            granule += ((rng() % 4) == 0) ? 128 : 1024;
+            granules.push_back(granule);
+        }
+
+        auto result = std::make_shared<std::ostringstream>();
+
+        {
+            ogg_stream os { std::make_shared<binary_ostream>(result), 1234, test.policy };
+
+            for (size_t i = 0; i < data.size(); ++i) {
+                ogg_packet packet = os.packet(reinterpret_cast<char*>(data[i].data()), static_cast<int64_t>(data[i].size()),
+                    i + 1 == data.size());
+                packet.granulepos = granules[i];
+
+                os.packetin(packet);
+
+                if (test.every_packet || (i % 5) == 0) {
+                    os.pageout();
+                }
+            }
+
+            os.flush();
+        }
+
+        BENCH_EXPECT(detail::check_pages(result->str(), data, granules,
+            { .max_packets = test.policy.max_packets, .max_granules = test.policy.max_granules }));
+    }
+
+    return true;
+}
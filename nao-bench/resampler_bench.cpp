@@ -0,0 +1,162 @@
+#include "bench.h"
+
+#include "resampler.h"
+
+#include <numbers>
+#include <limits>
+#include <cmath>
+
+namespace detail {
+    static constexpr resampler::quality qualities[] { resampler::quality::fast, resampler::quality::balanced, resampler::quality::best };
+
+    static const char* quality_name(resampler::quality quality) {
+        switch (quality) {
+            case resampler::quality::fast: return "fast";
+            case resampler::quality::best: return "best";
+            default:                       return "balanced";
+        }
+    }
+
+    // Interleaved sine at half scale, the same on every channel
+    static std::vector<float> sine(int64_t rate, size_t channels, int64_t frames, double freq) {
+        std::vector<float> result(static_cast<size_t>(frames) * channels);
+
+        for (int64_t i = 0; i < frames; ++i) {
+            const auto val = static_cast<float>(.5 * std::sin(2. * std::numbers::pi * freq * static_cast<double>(i) / static_cast<double>(rate)));
+            std::fill_n(result.begin() + static_cast<ptrdiff_t>(static_cast<size_t>(i) * channels), channels, val);
+        }
+
+        return result;
+    }
+
+    // Feed in as uneven blocks the way a decoder would, then flush
+    static std::vector<float> run(resampler& rs, const std::vector<float>& in, size_t channels) {
+        static constexpr int64_t block = 1237;
+
+        const auto frames = static_cast<int64_t>(in.size() / channels);
+        std::vector<float> result;
+
+        auto append = [&](int64_t capacity, auto&& convert) {
+            const size_t offset = result.size();
+            result.resize(offset + (static_cast<size_t>(capacity) * channels));
+            result.resize(offset + (static_cast<size_t>(convert(result.data() + offset, capacity)) * channels));
+        };
+
+        for (int64_t pos = 0; pos < frames; pos += block) {
+            const int64_t count = std::min(block, frames - pos);
+            append(rs.max_output(count), [&](float* out, int64_t capacity) {
+                return rs.process(in.data() + (static_cast<size_t>(pos) * channels), count, out, capacity);
+            });
+        }
+
+        append(rs.max_output(0), [&](float* out, int64_t capacity) { return rs.flush(out, capacity); });
+
+        return result;
+    }
+}
+
+BENCH_SUITE(resampler_snr) {
+    static constexpr double freq = 1000.;
+    static constexpr size_t channels = 2;
+
+    struct rate_pair {
+        int64_t in;
+        int64_t out;
+
+        // Lowest SNR accepted for fast, balanced and best, about 1 dB under what each measures now
+        double min_snr[3];
+    };
+
+    static constexpr rate_pair pairs[] {
+        { 44100, 48000, { 75., 91., 111. } },
+        { 48000, 44100, { 68., 89., 119. } },
+        { 32000, 48000, { 87., 84., 107. } },
+        { 22050, 48000, { 74., 90., 113. } },
+        { 96000, 48000, { 57., 86., 108. } },
+        { 48000, 48000, { 150., 150., 150. } }
+    };
+
+    for (const rate_pair& pair : pairs) {
+        for (size_t q = 0; q < std::size(detail::qualities); ++q) {
+            // Two seconds, not a multiple of the reduced ratio
+            const int64_t in_frames = (pair.in * 2) + 7;
+            const std::vector<float> in = detail::sine(pair.in, channels, in_frames, freq);
+
+            polyphase_resampler rs { channels, pair.in, pair.out, detail::qualities[q] };
+            const std::vector<float> out = detail::run(rs, in, channels);
+
+            // Exactly one output for every output period started by the input
+            const auto out_frames = static_cast<int64_t>(out.size() / channels);
+            BENCH_EXPECT(out_frames == ((in_frames * pair.out) + pair.in - 1) / pair.in);
+
+            // Against the ideal sine, away from the edges
+            double signal = 0.;
+            double noise = 0.;
+
+            for (int64_t i = out_frames / 4; i < (out_frames * 3) / 4; ++i) {
+                const double expected = .5 * std::sin(2. * std::numbers::pi * freq * static_cast<double>(i) / static_cast<double>(pair.out));
+
+                for (size_t c = 0; c < channels; ++c) {
+                    const double error = out[(static_cast<size_t>(i) * channels) + c] - expected;
+                    signal += expected * expected;
+                    noise += error * error;
+                }
+            }
+
+            const double snr = (noise > 0.) ? 10. * std::log10(signal / noise) : std::numeric_limits<double>::infinity();
+            nao::coutln("  ", pair.in, "to", pair.out, detail::quality_name(detail::qualities[q]), ":", snr, "dB");
+
+            BENCH_EXPECT(snr >= pair.min_snr[q]);
+        }
+    }
+
+    return true;
+}
+
+BENCH_SUITE(resampler_bank_cache) {
+    // Usual rates are built once and kept
+    std::weak_ptr<const polyphase_resampler::filter_bank> common = polyphase_resampler::bank(44100, 48000, resampler::quality::best);
+    BENCH_EXPECT(!common.expired());
+    BENCH_EXPECT(common.lock() == polyphase_resampler::bank(88200, 96000, resampler::quality::best));
+
+    // Odd ratios are shared while in use, and freed after
+    std::weak_ptr<const polyphase_resampler::filter_bank> odd;
+
+    {
+        polyphase_resampler first { 2, 47999, 48000, resampler::quality::fast };
+        polyphase_resampler second { 2, 47999, 48000, resampler::quality::fast };
+
+        odd = polyphase_resampler::bank(47999, 48000, resampler::quality::fast);
+        BENCH_EXPECT(!odd.expired());
+        BENCH_EXPECT(odd.lock()->coefs.size() == 48000u * 16u);
+        BENCH_EXPECT(odd.use_count() == 2);
+    }
+
+    BENCH_EXPECT(odd.expired());
+
+    return true;
+}
+
+BENCH_SUITE(resampler_throughput) {
+    // Ten seconds of stereo, 44.1 to 48 kHz
+    static constexpr size_t channels = 2;
+    const std::vector<float> in = detail::sine(44100, channels, 441000, 1000.);
+
+    for (resampler::quality quality : detail::qualities) {
+        const double seconds = bench_time([&] {
+            polyphase_resampler rs { channels, 44100, 48000, quality };
+            detail::run(rs, in, channels);
+        });
+
+        nao::coutln("  polyphase", detail::quality_name(quality), ":", 10. / seconds, "x real time");
+    }
+
+    const double seconds = bench_time([&] {
+        swr_resampler rs { channels, 44100, 48000 };
+        detail::run(rs, in, channels);
+    });
+
+    nao::coutln("  swresample:", 10. / seconds, "x real time");
+
+    return true;
+}
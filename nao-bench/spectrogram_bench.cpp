@@ -0,0 +1,49 @@
+#include "bench.h"
+#include "test_provider.h"
+
+#include "spectrogram.h"
+#include "thread_pool.h"
+
+BENCH_SUITE(spectrogram_throughput) {
+    // A minute of stereo at 48 kHz
+    static constexpr int64_t rate = 48000;
+    static constexpr int64_t frames = rate * 60;
+
+    struct size_hop {
+        size_t size;
+        size_t hop;
+    };
+
+    static constexpr size_hop settings[] { { 1024, 256 }, { 2048, 512 }, { 4096, 1024 }, { 1024, 4096 } };
+
+    const size_t cores = std::max<size_t>(thread_pool::pool_size(), 1);
+
+    std::vector<size_t> counts;
+    for (size_t threads = 1; threads < cores; threads *= 2) {
+        counts.push_back(threads);
+    }
+
+    counts.push_back(cores);
+
+    for (const size_hop& setting : settings) {
+        spectrogram_settings options;
+        options.size = setting.size;
+        options.hop = setting.hop;
+
+        for (size_t threads : counts) {
+            size_t columns = 0;
+
+            const double seconds = bench_time([&] {
+                columns = spectrogram::compute(std::make_shared<sine_provider>(rate, 2, frames), options, threads).columns();
+            }, 3);
+
+            // Every hop that starts before the end gets a column
+            BENCH_EXPECT(columns == static_cast<size_t>((frames + static_cast<int64_t>(setting.hop) - 1) / static_cast<int64_t>(setting.hop)));
+
+            nao::coutln("  size", setting.size, "hop", setting.hop, "with", threads, "threads:",
+                static_cast<double>(frames) / static_cast<double>(rate) / seconds, "audio seconds per second");
+        }
+    }
+
+    return true;
+}
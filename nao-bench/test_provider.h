@@ -0,0 +1,31 @@
+#pragma once
+
+#include "pcm_provider.h"
+
+// Interleaved float sines of a different frequency per channel, for driving the audio code without files
+class sine_provider : public pcm_provider {
+    static constexpr int64_t block_frames = 4096;
+
+    int64_t _rate;
+    int64_t _channels;
+    uint64_t _layout;
+    int64_t _frames;
+
+    int64_t _pos = 0;
+
+    public:
+    // layout 0 for the default mask of the channel count
+    sine_provider(int64_t rate, int64_t channels, int64_t frames, uint64_t layout = 0);
+
+    pcm_samples get_samples() override;
+    int64_t rate() override;
+    int64_t channels() override;
+    uint64_t channel_layout() override;
+    std::string name() override;
+
+    std::chrono::nanoseconds duration() override;
+    std::chrono::nanoseconds pos() override;
+    void seek(std::chrono::nanoseconds pos) override;
+
+    sample_format format() override;
+};
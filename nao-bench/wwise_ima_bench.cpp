@@ -0,0 +1,121 @@
+#include "bench.h"
+
+#include "wwise_ima_provider.h"
+#include "vector_streambuf.h"
+
+#include <random>
+
+namespace detail {
+    // Data chunk of random nibbles behind valid block headers
+    static std::vector<std::byte> make_blocks(size_t channels, size_t channel_size, size_t bytes, uint32_t seed) {
+        std::mt19937 rng { seed };
+
+        std::vector<std::byte> data(bytes);
+        std::ranges::generate(data, [&] { return static_cast<std::byte>(rng()); });
+
+        const size_t align = channels * channel_size;
+        for (size_t block = 0; block < bytes; block += align) {
+            for (size_t c = 0; c < channels && (block + (c * 4) + 4) <= bytes; ++c) {
+                // Step index in range, reserved byte cleared
+                data[block + (c * 4) + 2] = static_cast<std::byte>(rng() % 89);
+                data[block + (c * 4) + 3] = std::byte { 0 };
+            }
+        }
+
+        return data;
+    }
+
+    static wwriff::wem_info make_info(size_t channels, size_t channel_size, size_t bytes, uint32_t sample_count) {
+        return {
+            .format = 0x0002,
+            .channels = static_cast<uint16_t>(channels),
+            .rate = 48000,
+            .bits = 4,
+            .align = static_cast<uint16_t>(channels * channel_size),
+            .sample_count = sample_count,
+            .data_offset = 0,
+            .data_size = static_cast<std::streamsize>(bytes)
+        };
+    }
+
+    static istream_ptr make_stream(std::vector<std::byte> data) {
+        return std::make_shared<binary_istream>(std::make_unique<vector_streambuf>(std::move(data)));
+    }
+
+    static std::vector<int16_t> decode_all(wwise_ima_provider& provider) {
+        std::vector<int16_t> result;
+
+        while (true) {
+            pcm_samples samples = provider.get_samples();
+            if (samples.frames() == 0) {
+                break;
+            }
+
+            const int16_t* data = samples.data<sample_format::int16>();
+            result.insert(result.end(), data, data + (samples.frames() * samples.channels()));
+        }
+
+        return result;
+    }
+}
+
+BENCH_SUITE(wwise_ima_frames) {
+    // 3 full stereo blocks of 0x24 bytes per channel, and a 0x14 byte tail per channel
+    const size_t bytes = (3 * 0x48) + 0x28;
+    const auto data = detail::make_blocks(2, 0x24, bytes, 1);
+
+    wwise_ima_provider full { detail::make_stream(data), detail::make_info(2, 0x24, bytes, 0) };
+    const std::vector<int16_t> all = detail::decode_all(full);
+
+    // 64 frames per block, 32 in the tail
+    BENCH_EXPECT(wwise_ima_provider::block_frames(detail::make_info(2, 0x24, bytes, 0)) == 64);
+    BENCH_EXPECT(all.size() == ((3 * 64) + 32) * 2);
+
+    // First frame of every block is its header sample
+    for (size_t block = 0; block < 4; ++block) {
+        for (size_t c = 0; c < 2; ++c) {
+            const size_t header = (block * 0x48) + (c * 4);
+            const auto expected = static_cast<int16_t>(static_cast<uint16_t>(data[header]) | (static_cast<uint16_t>(data[header + 1]) << 8));
+
+            BENCH_EXPECT(all[(block * 64 * 2) + c] == expected);
+        }
+    }
+
+    // The header's sample count ends the stream early
+    wwise_ima_provider counted { detail::make_stream(data), detail::make_info(2, 0x24, bytes, 200) };
+    BENCH_EXPECT(detail::decode_all(counted).size() == 200 * 2);
+
+    // Seeking into a block decodes the same samples
+    wwise_ima_provider seeked { detail::make_stream(data), detail::make_info(2, 0x24, bytes, 0) };
+    seeked.seek(std::chrono::nanoseconds { 70 * 1'000'000'000i64 / 48000 + 1 });
+
+    const std::vector<int16_t> rest = detail::decode_all(seeked);
+    BENCH_EXPECT(rest.size() == all.size() - (70 * 2));
+    BENCH_EXPECT(std::equal(rest.begin(), rest.end(), all.begin() + (70 * 2)));
+
+    return true;
+}
+
+BENCH_SUITE(wwise_ima_decode) {
+    // A minute of 48 kHz audio in the usual Wwise block size
+    for (size_t channels : { 1u, 2u, 6u }) {
+        const size_t blocks = (48000 * 60) / 64;
+        const size_t bytes = blocks * channels * 0x24;
+
+        const auto data = detail::make_blocks(channels, 0x24, bytes, 2);
+        const wwriff::wem_info info = detail::make_info(channels, 0x24, bytes, 0);
+
+        size_t frames = 0;
+        const double time = bench_time([&] {
+            wwise_ima_provider provider { detail::make_stream(data), info };
+            frames = detail::decode_all(provider).size() / channels;
+        }, 3);
+
+        BENCH_EXPECT(frames == blocks * 64);
+
+        nao::coutln("  ", channels, "channels:", static_cast<double>(bytes) / time / 1e6, "MB/s,",
+            static_cast<double>(frames) / 48000. / time, "x realtime");
+    }
+
+    return true;
+}